@@ -7,6 +7,7 @@
 #define __HOBO_VR_LIB
 
 #include <unordered_map>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <vector>
@@ -14,10 +15,17 @@
 #include <string>
 #include <iostream>
 #include <cmath>
+#include <cstring>
 
 #include <stdio.h>
 #include <stdarg.h>
 
+// sse2 is always there on x64, on x86 only if the compiler was told so
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HVR_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace hvr {
 
 // hobovr_log.h
@@ -91,6 +99,16 @@ static const std::string g_sMessageTerminator = "\t\r\n"; // has to be exactly 3
 static const std::string g_sPoserIdMsg   = "holla"; // has to be exactly 5 characters
 static const std::string g_sManagerIdMsg = "monky"; // has to be exactly 5 characters
 
+// frame magics, have to match the driver, see driver/src/ref/hobovr_frames.h
+static const uint32_t g_unFrameMagic_Sparse = 0x7FC0A001;
+static const uint32_t g_unFrameMagic_Compact = 0x7FC0A002;
+static const uint32_t g_unFrameMagic_Addressed = 0x7FC0A003;
+static const uint32_t g_unFrameMagic_InputEvents = 0x7FC0A004;
+static const uint32_t g_unFrameMagic_Imu = 0x7FC0A005;
+
+// compact records carry the standard 22 float controller layout at most, wider devices are sent in sparse frames instead
+static const int g_iCompactMaxEndpoints = 22;
+
 // device pose objects
 #pragma pack(push, 1)
 struct Quat
@@ -177,6 +195,244 @@ struct TrackerPose: Pose {
     const char type_id() { return 't'; }
 };
 
+// compact frame records, have to match the driver, see driver/src/ref/hobovr_frames.h
+#pragma pack(push, 1)
+struct SparseFrameHeader {
+    uint32_t magic; // g_unFrameMagic_Sparse
+    uint32_t mask_lo; // devices 0-31
+    uint32_t mask_hi; // devices 32-63
+    float sample_age; // seconds between the newest sample in the frame being taken and the frame being sent, 0 if unknown
+};
+
+struct CompactFrameHeader {
+    uint32_t magic; // g_unFrameMagic_Compact
+    uint32_t mask_lo; // devices 0-31
+    uint32_t mask_hi; // devices 32-63
+    float position_range; // positions are fixed point in [-position_range, position_range] meters
+};
+
+struct CompactPose {
+    int16_t loc[3]; // loc/position_range*32767
+    uint32_t rot; // smallest three quaternion
+    uint16_t vel[3]; // half floats
+    uint16_t ang_vel[3]; // half floats
+}; // 22 bytes
+
+struct CompactControllerPose {
+    CompactPose pose;
+    uint8_t buttons; // bit 0 grip, 1 system, 2 menu, 3 trackpad_click, 4 trackpad_touch, 5 trigger_click
+    uint16_t axes[3]; // half floats: trigger_value, trackpad_x, trackpad_y
+}; // 29 bytes
+
+struct AddressedFrameHeader {
+    uint32_t magic; // g_unFrameMagic_Addressed
+    uint32_t record_count;
+};
+
+struct AddressedRecordHeader {
+    uint16_t device; // index in the udu list
+    uint16_t sequence; // per device, incremented by one for every record sent to that device
+    float sample_age; // seconds between the sample being taken and the frame being sent, 0 if unknown
+};
+
+struct InputEventFrameHeader {
+    uint32_t magic; // g_unFrameMagic_InputEvents
+    uint32_t event_count;
+};
+
+// controller input change, forwarded by the driver as soon as it arrives
+struct InputEvent {
+    uint16_t device; // index in the udu list, has to be a controller
+    uint8_t type; // InputEventType
+    uint8_t axis; // InputEventAxis, axis events only
+    float sample_age; // seconds between the input changing and the frame being sent
+    uint16_t buttons; // button events only, InputEventButton bits, state of every button
+    uint16_t changed; // button events only, InputEventButton bits, which buttons changed
+    float value; // axis events only
+}; // 16 bytes
+
+struct ImuFrameHeader {
+    uint32_t magic; // g_unFrameMagic_Imu
+    uint32_t sample_count;
+};
+
+// raw imu sample or optical position fix, fused by the driver, see driver/src/ref/hobovr_imu_fusion.h
+struct ImuSample {
+    uint16_t device; // index in the udu list
+    uint8_t type; // ImuSampleType
+    uint8_t reserved;
+    float sample_age; // seconds between the sample being taken and the frame being sent
+    float a[3]; // inertial: gyro, rad/s, device frame; optical: position, meters
+    float b[3]; // inertial: accelerometer, m/s^2, device frame, reads +g up at rest; optical: b[0] is the position std dev in meters, 0 for the default
+}; // 32 bytes
+#pragma pack(pop)
+
+enum ImuSampleType {
+    ImuSample_Inertial = 0,
+    ImuSample_Optical = 1,
+};
+
+enum InputEventType {
+    InputEvent_Buttons = 0,
+    InputEvent_Axis = 1,
+};
+
+enum InputEventButton {
+    InputButton_Grip = 1 << 0,
+    InputButton_System = 1 << 1,
+    InputButton_Menu = 1 << 2,
+    InputButton_TrackpadClick = 1 << 3,
+    InputButton_TrackpadTouch = 1 << 4,
+    InputButton_TriggerClick = 1 << 5,
+};
+
+enum InputEventAxis {
+    InputAxis_Trigger = 0,
+    InputAxis_TrackpadX = 1,
+    InputAxis_TrackpadY = 2,
+};
+
+// packs a hand state for a 'k' input schema entry into 2 floats of a device record, see driver/src/ref/hobovr_skeleton.h
+// curls are thumb, index, middle, ring, pinky in [0, 1], splay is in [-1, 1], 0 is neutral
+inline void pack_hand_curls(const float curls[5], float splay, float out[2]) {
+    uint8_t b[8] = {};
+    for (int i=0; i < 5; i++)
+        b[i] = (uint8_t)std::lround(std::fmin(std::fmax(curls[i], 0.f), 1.f) * 255.f);
+
+    b[5] = (uint8_t)std::lround(std::fmin(std::fmax(splay, -1.f), 1.f) * 127.f + 128.f);
+    memcpy(out, b, sizeof(b));
+}
+
+// compact encoders, branch free, sse2 versions do 4 values at a time
+#ifdef HVR_USE_SSE2
+inline __m128i float_to_half4(__m128 f) {
+    const __m128i f16max = _mm_set1_epi32((127 + 16) << 23); // everything from here up is inf
+    const __m128i min_normal = _mm_set1_epi32((127 - 14) << 23); // everything below is a half denormal
+    const __m128i subnorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23)); // rebias exponent, add rounding
+
+    __m128 justsign = _mm_and_ps(f, _mm_castsi128_ps(_mm_set1_epi32(0x80000000u)));
+    __m128 absf = _mm_xor_ps(f, justsign);
+    __m128i absf_int = _mm_castps_si128(absf);
+
+    __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+    __m128i is_regular = _mm_cmpgt_epi32(f16max, absf_int);
+    __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+    // half denormal results
+    __m128i is_sub = _mm_cmpgt_epi32(min_normal, absf_int);
+    __m128i subnorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absf, _mm_castsi128_ps(subnorm_magic))), subnorm_magic);
+
+    // normal results, round to nearest even
+    __m128i mant_odd = _mm_srai_epi32(_mm_slli_epi32(absf_int, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absf_int, normal_bias), mant_odd), 13);
+
+    __m128i nonspecial = _mm_or_si128(_mm_and_si128(is_sub, subnorm), _mm_andnot_si128(is_sub, normal));
+    __m128i joined = _mm_or_si128(_mm_and_si128(is_regular, nonspecial), _mm_andnot_si128(is_regular, inf_or_nan));
+    return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(justsign), 16));
+}
+
+// w, x, y, z are 4 quaternions as structure of arrays
+inline __m128i quat_to_smallest_three4(__m128 w, __m128 x, __m128 y, __m128 z) {
+    auto sel = [](__m128 m, __m128 t, __m128 f) { return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f)); };
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000u));
+
+    // normalize, zero length quaternions end up as identity
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w, w), _mm_mul_ps(x, x)), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(len, _mm_set1_ps(1e-12f)));
+    w = _mm_mul_ps(w, inv);
+    x = _mm_mul_ps(x, inv);
+    y = _mm_mul_ps(y, inv);
+    z = _mm_mul_ps(z, inv);
+
+    __m128 aw = _mm_andnot_ps(sign_mask, w);
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 ay = _mm_andnot_ps(sign_mask, y);
+    __m128 az = _mm_andnot_ps(sign_mask, z);
+    __m128 m = _mm_max_ps(_mm_max_ps(aw, ax), _mm_max_ps(ay, az));
+
+    __m128 is0 = _mm_cmpeq_ps(aw, m);
+    __m128 is1 = _mm_andnot_ps(is0, _mm_cmpeq_ps(ax, m));
+    __m128 is01 = _mm_or_ps(is0, is1);
+    __m128 is2 = _mm_andnot_ps(is01, _mm_cmpeq_ps(ay, m));
+    __m128 is3 = _mm_andnot_ps(_mm_or_ps(is01, is2), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+    // q and -q are the same rotation, flip so the dropped component is positive
+    __m128 flip = _mm_and_ps(sel(is0, w, sel(is1, x, sel(is2, y, z))), sign_mask);
+
+    // idx 0: (x, y, z), 1: (w, y, z), 2: (w, x, z), 3: (w, x, y)
+    __m128 a = _mm_xor_ps(sel(is0, x, w), flip);
+    __m128 b = _mm_xor_ps(sel(is01, y, x), flip);
+    __m128 c = _mm_xor_ps(sel(is3, y, z), flip);
+
+    const __m128 bias = _mm_set1_ps(0.70710678f);
+    const __m128 scale = _mm_set1_ps(1022.f / 1.41421356f);
+    const __m128 hi = _mm_set1_ps(1022.f);
+    auto quant = [&](__m128 v) {
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(v, bias), scale), _mm_setzero_ps()), hi));
+    };
+
+    __m128i idx = _mm_or_si128(
+        _mm_and_si128(_mm_castps_si128(is1), _mm_set1_epi32(1 << 30)),
+        _mm_or_si128(
+            _mm_and_si128(_mm_castps_si128(is2), _mm_set1_epi32(2 << 30)),
+            _mm_and_si128(_mm_castps_si128(is3), _mm_set1_epi32(3u << 30))
+        )
+    );
+
+    return _mm_or_si128(
+        _mm_or_si128(idx, _mm_slli_epi32(quant(a), 20)),
+        _mm_or_si128(_mm_slli_epi32(quant(b), 10), quant(c))
+    );
+}
+#endif
+
+inline uint16_t float_to_half(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+
+    // both paths are computed, the result is picked at the end
+    float fabs_f;
+    memcpy(&fabs_f, &u, sizeof(fabs_f));
+    const uint32_t subnorm_magic_u = ((127 - 15) + (23 - 10) + 1) << 23;
+    float subnorm_magic;
+    memcpy(&subnorm_magic, &subnorm_magic_u, sizeof(subnorm_magic));
+    float sub_f = fabs_f + subnorm_magic;
+    uint32_t sub;
+    memcpy(&sub, &sub_f, sizeof(sub));
+    sub -= subnorm_magic_u;
+
+    uint32_t normal = (u + (0xfff - ((127u - 15) << 23)) + ((u >> 13) & 1)) >> 13;
+    uint32_t inf_or_nan = (u > (255u << 23)) ? 0x7e00 : 0x7c00;
+
+    uint32_t o = (u < (113u << 23)) ? sub : normal;
+    o = (u >= ((127u + 16) << 23)) ? inf_or_nan : o;
+    return (uint16_t)(o | (sign >> 16));
+}
+
+inline uint32_t quat_to_smallest_three(Quat q) {
+    float len = std::sqrt(q.w*q.w + q.x*q.x + q.y*q.y + q.z*q.z);
+    float inv = 1.f / (len > 1e-12f ? len : 1e-12f);
+    float v[4] = {q.w*inv, q.x*inv, q.y*inv, q.z*inv};
+
+    uint32_t idx = 0;
+    for (uint32_t i = 1; i < 4; i++)
+        idx = std::fabs(v[i]) > std::fabs(v[idx]) ? i : idx;
+
+    float flip = v[idx] < 0 ? -1.f : 1.f; // q and -q are the same rotation
+    uint32_t out = idx << 30;
+    for (uint32_t i = 0, k = 0; i < 4; i++) {
+        float t = (v[i]*flip + 0.70710678f) * (1022.f / 1.41421356f);
+        uint32_t qv = (uint32_t)std::lround(std::fmin(std::fmax(t, 0.f), 1022.f));
+        out |= (i != idx) ? qv << (20 - 10*k) : 0;
+        k += (i != idx);
+    }
+
+    return out;
+}
+
 enum HobovrTrackingRef_Msg_type
 {
   Emsg_invalid = 0,
@@ -186,12 +442,13 @@ enum HobovrTrackingRef_Msg_type
   Emsg_distortion = 40,
   Emsg_eyeGap = 50,
   Emsg_setSelfPose = 60,
+  Emsg_calibration = 70,
 };
 
 // the only allowed manager communication type 
 struct ManagerPacket {
     uint32_t msg_type; // has to be one of HobovrTrackingRef_Msg_type
-    uint32_t data[129];
+    uint32_t data[129] = {};
 
     int len_bytes() {
         return 520; // 130*sizeof(int)
@@ -306,6 +563,24 @@ public:
         m_spManagerSockComm->send2(g_sMessageTerminator.c_str());
     }
 
+    // sets the world from source calibration of device i, or the default one if i is -1
+    // world = trans + scale * rot * remap(source), world axis j is source axis |axes[j]| - 1, negated if axes[j] < 0
+    void _send_calibration(int i, const float rot[4], const float trans[3], float scale, const int axes[3]) {
+        ManagerPacket msg = { HobovrTrackingRef_Msg_type::Emsg_calibration };
+        const float v[8] = {rot[0], rot[1], rot[2], rot[3], trans[0], trans[1], trans[2], scale};
+
+        msg.data[0] = (uint32_t)i; // -1 wraps to 0xFFFFFFFF
+        for (int j = 0; j < 8; j++) {
+            msg.data[1 + j*2] = (uint32_t)(int32_t)std::lround(v[j] * 1000000.f); // signed fixed point
+            msg.data[2 + j*2] = 1000000;
+        }
+
+        for (int j = 0; j < 3; j++)
+            msg.data[17 + j] = (uint32_t)axes[j];
+
+        _send_manager(msg);
+    }
+
     virtual void _cli_arg_map(std::pair<std::string, std::string>) {}
 
     virtual void send() = 0; // lmao, override this
@@ -411,6 +686,15 @@ private:
     bool m_bAbout2ChangePoses = false;
 protected:
     std::vector<Pose*> m_vPoses; // NEVER modify it yourself
+    bool m_bSparseFrames = false; // only send devices marked with mark_updated(), for mostly static setups and addressed frames
+    std::atomic<uint64_t> m_ulUpdatedMask{0}; // devices marked with mark_updated() since the last send, marked from the caller's thread
+    std::atomic<int64_t> m_llLastMarkTime{0}; // steady clock ticks of the last mark_updated(), sparse frames count their sample age from it
+    std::chrono::steady_clock::time_point m_tLastSparseSend; // send thread only, paces the heartbeat
+    static constexpr std::chrono::milliseconds k_tSparseHeartbeat{20}; // well under the driver's default watchdog stale time
+    bool m_bCompactFrames = false; // quantize poses, 22 bytes per pose instead of 52, 29 per controller instead of 88, devices over 22 floats stay sparse
+    float m_fCompactPositionRange = 8.f; // compact positions have to be within +-this many meters
+    bool m_bAddressedFrames = false; // send marked devices as addressed records, lets every device run at its own rate
+    uint16_t m_vusSequence[64] = {}; // next addressed frame sequence number of every device
 
 public:
     UduPoserTemplate( std::string udu_string,
@@ -520,10 +804,219 @@ Options:
         }
     }
 
+    // mark device i as changed, it will be in the next sparse frame
+    void mark_updated(int i) {
+        if (i >= 0 && i < 64) {
+            m_llLastMarkTime.store(std::chrono::steady_clock::now().time_since_epoch().count());
+            m_ulUpdatedMask.fetch_or(1ull << i);
+        }
+    }
+
+    // send a sparse frame containing only the devices set in device_mask
+    // sample_age is how old the newest pose is in seconds, the driver uses it to time stamp them
+    void _send_sparse(uint64_t device_mask, float sample_age=0.f) {
+        SparseFrameHeader header = {g_unFrameMagic_Sparse, (uint32_t)device_mask, (uint32_t)(device_mask >> 32), sample_age};
+        m_spSockComm->send2((const char*)&header, sizeof(header));
+
+        int count = m_vPoses.size() < 64 ? (int)m_vPoses.size() : 64;
+        for (int i=0; i < count; i++) {
+            if ((device_mask >> i) & 1)
+                m_spSockComm->send2(m_vPoses[i]->_to_pchar(), m_vPoses[i]->len_bytes());
+        }
+
+        m_spSockComm->send2(g_sMessageTerminator.c_str());
+    }
+
+    // send an addressed frame containing only the devices set in device_mask
+    // call this from the tracking loop of each device to send it at its own rate
+    // sample_age is how old the poses are in seconds, the driver uses it to time stamp them
+    void _send_addressed(uint64_t device_mask, float sample_age=0.f) {
+        int count = m_vPoses.size() < 64 ? (int)m_vPoses.size() : 64;
+
+        AddressedFrameHeader header = {g_unFrameMagic_Addressed, 0};
+        for (int i=0; i < count; i++)
+            header.record_count += (device_mask >> i) & 1;
+
+        m_spSockComm->send2((const char*)&header, sizeof(header));
+
+        for (int i=0; i < count; i++) {
+            if (!((device_mask >> i) & 1))
+                continue;
+
+            AddressedRecordHeader record = {(uint16_t)i, m_vusSequence[i]++, sample_age};
+            m_spSockComm->send2((const char*)&record, sizeof(record));
+            m_spSockComm->send2(m_vPoses[i]->_to_pchar(), m_vPoses[i]->len_bytes());
+        }
+
+        m_spSockComm->send2(g_sMessageTerminator.c_str());
+    }
+
+    // send controller input changes right away, oldest first
+    // once a controller got an input event the driver ignores the inputs in its pose records
+    void _send_input_events(const InputEvent* events, int count) {
+        InputEventFrameHeader header = {g_unFrameMagic_InputEvents, (uint32_t)count};
+        m_spSockComm->send2((const char*)&header, sizeof(header));
+        m_spSockComm->send2((const char*)events, count*sizeof(InputEvent));
+        m_spSockComm->send2(g_sMessageTerminator.c_str());
+    }
+
+    // send raw imu samples and optical fixes, oldest first
+    // the device has to be at rest for the first few inertial samples, the driver aligns to gravity with them
+    // while a device gets inertial samples the driver ignores the pose in its pose records
+    // the driver submits one fused pose per device per frame, batching samples lowers the pose rate to the frame rate
+    void _send_imu(const ImuSample* samples, int count) {
+        ImuFrameHeader header = {g_unFrameMagic_Imu, (uint32_t)count};
+        m_spSockComm->send2((const char*)&header, sizeof(header));
+        m_spSockComm->send2((const char*)samples, count*sizeof(ImuSample));
+        m_spSockComm->send2(g_sMessageTerminator.c_str());
+    }
+
+    // send the devices set in device_mask compact, devices wider than g_iCompactMaxEndpoints go in a sparse frame after it
+    void _send_compact_or_sparse(uint64_t device_mask, float sample_age=0.f) {
+        int count = m_vPoses.size() < 64 ? (int)m_vPoses.size() : 64;
+        uint64_t wide = 0;
+        for (int i=0; i < count; i++) {
+            if (((device_mask >> i) & 1) && m_vPoses[i]->len() > g_iCompactMaxEndpoints)
+                wide |= 1ull << i;
+        }
+
+        if (device_mask & ~wide)
+            _send_compact(device_mask & ~wide);
+
+        if (wide)
+            _send_sparse(wide, sample_age);
+    }
+
+    // send a compact frame containing only the devices set in device_mask
+    void _send_compact(uint64_t device_mask) {
+        int count = m_vPoses.size() < 64 ? (int)m_vPoses.size() : 64;
+
+        // gather into structure of arrays, padded to a multiple of 4
+        alignas(16) float soa[16][64 + 4] = {};
+        int slots[64];
+        int n = 0;
+        for (int i=0; i < count; i++) {
+            if (!((device_mask >> i) & 1))
+                continue;
+
+            Pose* p = m_vPoses[i];
+            float v[16] = {
+                p->loc.x, p->loc.y, p->loc.z,
+                p->rot.w, p->rot.x, p->rot.y, p->rot.z,
+                p->vel.x, p->vel.y, p->vel.z,
+                p->ang_vel.x, p->ang_vel.y, p->ang_vel.z,
+                0, 0, 0
+            };
+
+            if (p->type_id() == 'c') {
+                Ctrl* c = p->updateInputs();
+                v[13] = c->trigger_value;
+                v[14] = c->trackpad_x;
+                v[15] = c->trackpad_y;
+            }
+
+            for (int k=0; k < 16; k++)
+                soa[k][n] = v[k];
+            slots[n++] = i;
+        }
+
+        alignas(16) int32_t loc[3][64 + 4];
+        alignas(16) uint32_t rot[64 + 4];
+        alignas(16) int32_t halfs[9][64 + 4]; // vel, ang_vel, axes
+
+        float loc_scale = 32767.f / m_fCompactPositionRange;
+#ifdef HVR_USE_SSE2
+        __m128 vloc_scale = _mm_set1_ps(loc_scale);
+        for (int j=0; j < n; j += 4) {
+            for (int k=0; k < 3; k++) {
+                __m128 v = _mm_mul_ps(_mm_load_ps(&soa[k][j]), vloc_scale);
+                v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32767.f)), _mm_set1_ps(32767.f));
+                _mm_store_si128((__m128i*)&loc[k][j], _mm_cvtps_epi32(v));
+            }
+
+            _mm_store_si128((__m128i*)&rot[j], quat_to_smallest_three4(
+                _mm_load_ps(&soa[3][j]), _mm_load_ps(&soa[4][j]), _mm_load_ps(&soa[5][j]), _mm_load_ps(&soa[6][j])
+            ));
+
+            for (int k=0; k < 9; k++)
+                _mm_store_si128((__m128i*)&halfs[k][j], float_to_half4(_mm_load_ps(&soa[7 + k][j])));
+        }
+#else
+        for (int j=0; j < n; j++) {
+            for (int k=0; k < 3; k++)
+                loc[k][j] = (int32_t)std::lround(std::fmin(std::fmax(soa[k][j] * loc_scale, -32767.f), 32767.f));
+
+            rot[j] = quat_to_smallest_three({soa[3][j], soa[4][j], soa[5][j], soa[6][j]});
+
+            for (int k=0; k < 9; k++)
+                halfs[k][j] = float_to_half(soa[7 + k][j]);
+        }
+#endif
+
+        char buff[sizeof(CompactFrameHeader) + 64*sizeof(CompactControllerPose)];
+        CompactFrameHeader header = {g_unFrameMagic_Compact, (uint32_t)device_mask, (uint32_t)(device_mask >> 32), m_fCompactPositionRange};
+        memcpy(buff, &header, sizeof(header));
+        int size = sizeof(header);
+
+        for (int j=0; j < n; j++) {
+            CompactControllerPose rec = {};
+            for (int k=0; k < 3; k++) {
+                rec.pose.loc[k] = (int16_t)loc[k][j];
+                rec.pose.vel[k] = (uint16_t)halfs[k][j];
+                rec.pose.ang_vel[k] = (uint16_t)halfs[3 + k][j];
+                rec.axes[k] = (uint16_t)halfs[6 + k][j];
+            }
+            rec.pose.rot = rot[j];
+
+            Pose* p = m_vPoses[slots[j]];
+            if (p->type_id() == 'c') {
+                Ctrl* c = p->updateInputs();
+                rec.buttons = (uint8_t)(
+                    (c->grip > 0.5f) |
+                    ((c->system > 0.5f) << 1) |
+                    ((c->menu > 0.5f) << 2) |
+                    ((c->trackpad_click > 0.5f) << 3) |
+                    ((c->trackpad_touch > 0.5f) << 4) |
+                    ((c->trigger_click > 0.5f) << 5)
+                );
+
+                memcpy(buff + size, &rec, sizeof(CompactControllerPose));
+                size += sizeof(CompactControllerPose);
+            } else {
+                memcpy(buff + size, &rec.pose, sizeof(CompactPose));
+                size += sizeof(CompactPose);
+            }
+        }
+
+        m_spSockComm->send2(buff, size);
+        m_spSockComm->send2(g_sMessageTerminator.c_str());
+    }
+
     void send() {
         while (m_mThreadRegistry["send"].is_alive) {
             try {
-                if (!m_bAbout2ChangePoses) {
+                if (!m_bAbout2ChangePoses && m_bSparseFrames) {
+                    uint64_t mask = m_ulUpdatedMask.exchange(0);
+                    auto now = std::chrono::steady_clock::now();
+                    auto marked = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_llLastMarkTime.load()));
+                    float age = mask ? std::chrono::duration<float>(now - marked).count() : 0.f;
+
+                    // nothing marked, only a heartbeat every k_tSparseHeartbeat so idle devices aren't taken for stalled ones
+                    if (mask || now - m_tLastSparseSend >= k_tSparseHeartbeat) {
+                        if (mask && m_bCompactFrames)
+                            _send_compact_or_sparse(mask, age);
+                        else if (mask && m_bAddressedFrames)
+                            _send_addressed(mask, age);
+                        else
+                            _send_sparse(mask, age);
+
+                        m_tLastSparseSend = now;
+                    }
+
+                } else if (!m_bAbout2ChangePoses && m_bCompactFrames) {
+                    _send_compact_or_sparse(m_vPoses.size() >= 64 ? ~0ull : (1ull << m_vPoses.size()) - 1);
+
+                } else if (!m_bAbout2ChangePoses) {
                     for (auto i : m_vPoses)
                         m_spSockComm->send2(i->_to_pchar(), i->len_bytes());
 
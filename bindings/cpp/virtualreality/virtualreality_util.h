@@ -31,6 +31,13 @@ namespace utilz {
           return i + 1; // return length of message
         }
       }
+      // full and still no terminator, drop what's buffered and resync on the next terminator
+      // reading with no room left would return 0 forever
+      if( numbytes >= max_packet_size ) {
+        numbytes = 0;
+        i = 0;
+      }
+
       if constexpr(std::is_same<T, SOCKET>::value)
       {
         n = recv( sock, buf + numbytes, max_packet_size - numbytes, 0 );
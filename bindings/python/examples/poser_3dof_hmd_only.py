@@ -14,6 +14,9 @@ https://gist.github.com/okawo80085/76d1b0cfbbd1ec8c6dbd825c109f59a5
 this poser expects hobovr driver to have this udu setting:
 h13
 
+and NeckModelEnable set to true in the hobovr_device_hmd section,
+the driver then derives the head position from the rotation
+
 """
 
 import asyncio
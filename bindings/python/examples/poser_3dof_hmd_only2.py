@@ -10,6 +10,9 @@ only works with new hobovr arduino code, ask okawo for details
 this poser expects hobovr driver to have this udu setting:
 h13
 
+and NeckModelEnable set to true in the hobovr_device_hmd section,
+the driver then derives the head position from the rotation
+
 """
 
 import asyncio
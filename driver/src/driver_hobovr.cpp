@@ -10,7 +10,9 @@
 //#include "openvr_capi.h"
 #include "driverlog.h"
 
+#include <atomic>
 #include <chrono>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -61,6 +63,10 @@ namespace hobovr {
 // driver keys
 static const char *const k_pch_Hobovr_Section = "driver_hobovr";
 static const char *const k_pch_Hobovr_UduDeviceManifestList_String = "uduSettings";
+// spare devices per class constructed and registered on startup on top of the udu list, udu changes take them from the pool instead of constructing them
+static const char *const k_pch_Hobovr_DevicePoolHmds_Int32 = "DevicePoolHmds"; // at most 1, and only while the udu list has no hmd
+static const char *const k_pch_Hobovr_DevicePoolControllers_Int32 = "DevicePoolControllers";
+static const char *const k_pch_Hobovr_DevicePoolTrackers_Int32 = "DevicePoolTrackers";
 
 // hmd device keys
 static const char *const k_pch_Hmd_Section = "hobovr_device_hmd";
@@ -69,9 +75,28 @@ static const char *const k_pch_Hmd_DisplayFrequency_Float = "displayFrequency";
 static const char* const k_pch_Hmd_IPD_Float = "IPD";
 static const char* const k_pch_Hmd_UserHead2EyeDepthMeters_Float = "UserHeadToEyeDepthMeters";
 
+// tracker device keys
+static const char *const k_pch_Tracker_Section = "hobovr_device_tracker";
+
 // include has to be here, dont ask
 #include "ref/hobovr_device_base.h"
 #include "ref/hobovr_components.h"
+#include "ref/hobovr_pose_validation.h"
+#include "ref/hobovr_calibration.h"
+#include "ref/hobovr_outlier_gate.h"
+#include "ref/hobovr_frames.h"
+#include "ref/hobovr_input_schema.h"
+#include "ref/hobovr_prediction.h"
+#include "ref/hobovr_neck_model.h"
+#include "ref/hobovr_one_euro.h"
+#include "ref/hobovr_velocity.h"
+#include "ref/hobovr_upsampler.h"
+#include "ref/hobovr_watchdog.h"
+#include "ref/hobovr_rate_limiter.h"
+#include "ref/hobovr_vsync_scheduler.h"
+#include "ref/hobovr_work_pool.h"
+#include "ref/hobovr_pose_pipeline.h"
+#include "ref/hobovr_imu_fusion.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: hmd device implementation
@@ -104,6 +129,13 @@ public:
 			k_pch_Hmd_UserHead2EyeDepthMeters_Float
 		);
 
+		// the driver's neck model replaces steamvr's
+		bool bNeckModel = vr::VRSettings()->GetBool(k_pch_Hmd_Section, hobovr::k_pch_Hmd_NeckModelEnable_Bool);
+		{
+			std::lock_guard<std::mutex> lock(m_PoseMutex);
+			m_Pose.shouldApplyHeadModel = !bNeckModel;
+		}
+
 		// log non boilerplate device specific settings 
 		DriverLog("device hmd settings: vsync time %fs, display freq %f, ipd %fm, head2eye depth %fm",
 			m_flSecondsFromVsyncToPhotons,
@@ -182,53 +214,16 @@ public:
 		);
 
 		DriverLog("device hmd: ipd set to %f", m_flIPD);
-	}
 
+		bool bNeckModel = vr::VRSettings()->GetBool(k_pch_Hmd_Section, hobovr::k_pch_Hmd_NeckModelEnable_Bool);
+		std::lock_guard<std::mutex> lock(m_PoseMutex);
+		m_Pose.shouldApplyHeadModel = !bNeckModel;
+	}
 
-	void RunFrame(std::vector<float> &trackingPacket) override {
-		DriverPose_t pose;
-		pose.poseTimeOffset = m_fPoseTimeOffset;
-		pose.result = TrackingResult_Running_OK;
-		pose.poseIsValid = true;
-		pose.deviceIsConnected = true;
-		pose.willDriftInYaw = false;
-		pose.shouldApplyHeadModel = true;
-		pose.vecPosition[0] = trackingPacket[0];
-		pose.vecPosition[1] = trackingPacket[1];
-		pose.vecPosition[2] = trackingPacket[2];
-
-		pose.qRotation = {
-			(double)trackingPacket[3],
-			(double)trackingPacket[4],
-			(double)trackingPacket[5],
-			(double)trackingPacket[6]
-		};
-
-		pose.vecVelocity[0] = trackingPacket[7];
-		pose.vecVelocity[1] = trackingPacket[8];
-		pose.vecVelocity[2] = trackingPacket[9];
-
-		pose.vecAngularVelocity[0] = trackingPacket[10];
-		pose.vecAngularVelocity[1] = trackingPacket[11];
-		pose.vecAngularVelocity[2] = trackingPacket[12];
-
-		pose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
-		pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
-		pose.vecWorldFromDriverTranslation[0] = 0;
-		pose.vecWorldFromDriverTranslation[1] = 0;
-		pose.vecWorldFromDriverTranslation[2] = 0;
-
-		pose.vecDriverFromHeadTranslation[0] = 0;
-		pose.vecDriverFromHeadTranslation[1] = 0;
-		pose.vecDriverFromHeadTranslation[2] = 0;
 
-		if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated(
-				m_unObjectId,
-				pose,
-				sizeof(pose)
-			);
-		}
+	void RunFrame(const float* trackingPacket) override {
+		(void)trackingPacket; // hmd has nothing but the pose
+		SubmitPose();
 	}
 
 
@@ -248,13 +243,19 @@ public:
 	ControllerDriver(
 		bool side,
 		std::string myserial,
-		const std::shared_ptr<SockReceiver::DriverReceiver> ReceiverObj
-	): HobovrDevice(myserial, "hobovr_controller_m", ReceiverObj), m_bHandSide(side) {
+		const std::shared_ptr<SockReceiver::DriverReceiver> ReceiverObj,
+		std::mutex* pFrameMutex
+	): HobovrDevice(myserial, "hobovr_controller_m", ReceiverObj), m_bHandSide(side), m_pFrameMutex(pFrameMutex) {
 
 		m_sRenderModelPath = "{hobovr}/rendermodels/hobovr_controller_mc0";
 		m_sBindPath = "{hobovr}/input/hobovr_controller_profile.json";
 
-		m_skeletonHandle = vr::k_ulInvalidInputComponentHandle;
+		char buff[2048];
+		vr::VRSettings()->GetString(hobovr::k_pch_Controller_Section, hobovr::k_pch_Controller_InputSchema_String, buff, sizeof(buff));
+		if (!hobovr::ParseInputSchema(buff, m_vInputSchema)) {
+			DriverLog("controller: input schema '%s' is invalid, using the default one\n", buff);
+			hobovr::ParseInputSchema(hobovr::k_pch_Controller_DefaultInputSchema, m_vInputSchema);
+		}
 	}
 
 	EVRInitError Activate(vr::TrackedDeviceIndex_t unObjectId) {
@@ -438,209 +439,82 @@ public:
 				Prop_ControllerRoleHint_Int32,
 				TrackedControllerRole_RightHand
 			);
-		  // vr::VRDriverInput()->CreateSkeletonComponent(m_ulPropertyContainer, "/input/skeleton/right", 
-		  //                 "/skeleton/hand/right", 
-		  //                 "/pose/raw", vr::VRSkeletalTracking_Partial
-		  //                 , nullptr, 0U, &m_skeletonHandle);
 		} else {
 			vr::VRProperties()->SetInt32Property(
 				m_ulPropertyContainer,
 				Prop_ControllerRoleHint_Int32,
 				TrackedControllerRole_LeftHand
 			);
-			// vr::VRDriverInput()->CreateSkeletonComponent(m_ulPropertyContainer, "/input/skeleton/left", 
-			//                 "/skeleton/hand/left", 
-			//                 "/pose/raw", vr::VRSkeletalTracking_Partial
-			//                 , nullptr, 0U, &m_skeletonHandle);
 		}
 
-		// create all the bool input components
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/grip/click",
-			&m_compGrip
-		);
-
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/system/click",
-			&m_compSystem
-		);
-
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/application_menu/click",
-			&m_compAppMenu
-		);
-
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/trackpad/click",
-			&m_compTrackpadClick
-		);
-
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/trackpad/touch",
-			&m_compTrackpadTouch
-		);
-
-		vr::VRDriverInput()->CreateBooleanComponent(
-			m_ulPropertyContainer,
-			"/input/trigger/click",
-			&m_compTriggerClick
-		);
-
-
-		// trigger
-		vr::VRDriverInput()->CreateScalarComponent(
-			m_ulPropertyContainer,
-			"/input/trigger/value",
-			&m_compTrigger,
-			vr::VRScalarType_Absolute,
-			vr::VRScalarUnits_NormalizedOneSided
-		);
-
-		// trackpad
-		vr::VRDriverInput()->CreateScalarComponent(
-			m_ulPropertyContainer,
-			"/input/trackpad/x",
-			&m_compTrackpadX,
-			vr::VRScalarType_Absolute,
-			vr::VRScalarUnits_NormalizedTwoSided
-		);
-		vr::VRDriverInput()->CreateScalarComponent(
-			m_ulPropertyContainer,
-			"/input/trackpad/y",
-			&m_compTrackpadY,
-			vr::VRScalarType_Absolute,
-			vr::VRScalarUnits_NormalizedTwoSided
-		);
-
+		// input components, see hobovr_input_schema.h
+		// created on the side, the receiver may already be updating this device's inputs when vrserver activates it
+		hobovr::HobovrInputTable table;
+		table.Compile(m_ulPropertyContainer, m_vInputSchema, m_bHandSide);
+		{
+			std::lock_guard<std::mutex> lock(*m_pFrameMutex);
+			table.Bind(m_InputTable.GetRecordSize());
+			m_InputTable = std::move(table);
+		}
 
 		return VRInitError_None;
 	}
 
 
-	void RunFrame(std::vector<float> &lastRead) override {
+	void RunFrame(const float* lastRead) override {
 		// update all the things
-		DriverPose_t pose;
-		pose.poseTimeOffset = m_fPoseTimeOffset;
-		pose.result = TrackingResult_Running_OK;
-		pose.poseIsValid = true;
-		pose.deviceIsConnected = true;
-		pose.willDriftInYaw = false;
-		pose.shouldApplyHeadModel = true;
-		pose.vecPosition[0] = lastRead[0];
-		pose.vecPosition[1] = lastRead[1];
-		pose.vecPosition[2] = lastRead[2];
-
-		pose.qRotation = {
-			(double)lastRead[3],
-			(double)lastRead[4],
-			(double)lastRead[5],
-			(double)lastRead[6]
-		};
-
-		pose.vecVelocity[0] = lastRead[7];
-		pose.vecVelocity[1] = lastRead[8];
-		pose.vecVelocity[2] = lastRead[9];
-
-		pose.vecAngularVelocity[0] = lastRead[10];
-		pose.vecAngularVelocity[1] = lastRead[11];
-		pose.vecAngularVelocity[2] = lastRead[12];
-
-		pose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
-		pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
-		pose.vecWorldFromDriverTranslation[0] = 0;
-		pose.vecWorldFromDriverTranslation[1] = 0;
-		pose.vecWorldFromDriverTranslation[2] = 0;
+		SubmitPose();
+		UpdateInputs(lastRead);
+	}
 
-		pose.vecDriverFromHeadTranslation[0] = 0;
-		pose.vecDriverFromHeadTranslation[1] = 0;
-		pose.vecDriverFromHeadTranslation[2] = 0;
+	// inputs only, for when the pose comes from somewhere else than the record
+	void UpdateInputs(const float* lastRead) {
+		if (m_bInputEvents)
+			return; // inputs come from the event channel, the ones in the pose record are stale
 
-		if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated(
-				m_unObjectId,
-				pose,
-				sizeof(pose)
-			);
+		double poseTimeOffset;
+		{
+			std::lock_guard<std::mutex> lock(m_PoseMutex);
+			poseTimeOffset = m_Pose.poseTimeOffset;
 		}
+		m_InputTable.Update(lastRead, poseTimeOffset);
+	}
 
-		auto ivrinput_cache = vr::VRDriverInput();
-
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compGrip,
-			(bool)lastRead[13],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compSystem,
-			(bool)lastRead[14],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compAppMenu,
-			(bool)lastRead[15],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compTrackpadClick,
-			(bool)lastRead[16],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateScalarComponent(
-			m_compTrigger,
-			lastRead[17],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateScalarComponent(
-			m_compTrackpadX,
-			lastRead[18],
-			(double)m_fPoseTimeOffset
-		);
-
-		ivrinput_cache->UpdateScalarComponent(
-			m_compTrackpadY,
-			lastRead[19],
-			(double)m_fPoseTimeOffset
-		);
+	// limits the inputs read from records to what fits in the device's udu record
+	void BindInputRecordSize(uint32_t unRecordSize) {
+		m_InputTable.Bind(unRecordSize);
+	}
 
+	// forwards an input event right away, fTimeOffset is how long ago the input changed, negative
+	void ProcessInputEvent(const hobovr::HobovrInputEvent_t& event, double fTimeOffset) {
+		m_bInputEvents = true;
 
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compTrackpadTouch,
-			(bool)lastRead[20],
-			(double)m_fPoseTimeOffset
-		);
+		if (event.type == hobovr::EHobovrInputEvent_Buttons) {
+			// button bit i is the i-th boolean in the input schema
+			uint32_t count = std::min(m_InputTable.GetBooleanCount(), 16u);
+			for (uint32_t i = 0; i < count; i++) {
+				if ((event.changed >> i) & 1)
+					m_InputTable.UpdateBoolean(i, (event.buttons >> i) & 1, fTimeOffset);
+			}
 
-		ivrinput_cache->UpdateBooleanComponent(
-			m_compTriggerClick,
-			(bool)lastRead[21],
-			(double)m_fPoseTimeOffset
-		);
+		} else if (event.type == hobovr::EHobovrInputEvent_Axis) {
+			// axis i is the i-th scalar in the input schema
+			m_InputTable.UpdateScalar(event.axis, event.value, fTimeOffset);
+		}
+	}
 
+	void PowerOff() override {
+		HobovrDevice::PowerOff();
+		m_bInputEvents = false; // the next poser might not use input events
 	}
 
 private:
-	vr::VRInputComponentHandle_t m_compGrip;
-	vr::VRInputComponentHandle_t m_compSystem;
-	vr::VRInputComponentHandle_t m_compAppMenu;
-	vr::VRInputComponentHandle_t m_compTrigger;
-	vr::VRInputComponentHandle_t m_compTrackpadX;
-	vr::VRInputComponentHandle_t m_compTrackpadY;
-	vr::VRInputComponentHandle_t m_compTrackpadTouch;
-	vr::VRInputComponentHandle_t m_compTriggerClick;
-	vr::VRInputComponentHandle_t m_compTrackpadClick;
-
-	vr::VRInputComponentHandle_t m_skeletonHandle;
+	std::vector<hobovr::HobovrInputSchemaEntry_t> m_vInputSchema;
+	hobovr::HobovrInputTable m_InputTable;
 
 	bool m_bHandSide;
+	std::mutex* m_pFrameMutex; // the server driver's, held by the receiver for a whole frame
+	std::atomic<bool> m_bInputEvents{false}; // got input events, inputs in pose records are ignored from then on, set on the receiver thread, cleared on power off
 
 };
 
@@ -672,51 +546,10 @@ public:
   }
 
 
-	void RunFrame(std::vector<float> &lastRead) override {
+	void RunFrame(const float* lastRead) override {
+		(void)lastRead; // trackers have nothing but the pose
 		// update all the things
-		DriverPose_t pose;
-		pose.poseTimeOffset = m_fPoseTimeOffset;
-		pose.result = TrackingResult_Running_OK;
-		pose.poseIsValid = true;
-		pose.deviceIsConnected = true;
-		pose.willDriftInYaw = false;
-		pose.shouldApplyHeadModel = true;
-		pose.vecPosition[0] = lastRead[0];
-		pose.vecPosition[1] = lastRead[1];
-		pose.vecPosition[2] = lastRead[2];
-
-		pose.qRotation = {
-			(double)lastRead[3],
-			(double)lastRead[4],
-			(double)lastRead[5],
-			(double)lastRead[6]
-		};
-
-		pose.vecVelocity[0] = lastRead[7];
-		pose.vecVelocity[1] = lastRead[8];
-		pose.vecVelocity[2] = lastRead[9];
-
-		pose.vecAngularVelocity[0] = lastRead[10];
-		pose.vecAngularVelocity[1] = lastRead[11];
-		pose.vecAngularVelocity[2] = lastRead[12];
-
-		pose.qWorldFromDriverRotation = { 1, 0, 0, 0 };
-		pose.qDriverFromHeadRotation = { 1, 0, 0, 0 };
-		pose.vecWorldFromDriverTranslation[0] = 0;
-		pose.vecWorldFromDriverTranslation[1] = 0;
-		pose.vecWorldFromDriverTranslation[2] = 0;
-
-		pose.vecDriverFromHeadTranslation[0] = 0;
-		pose.vecDriverFromHeadTranslation[1] = 0;
-		pose.vecDriverFromHeadTranslation[2] = 0;
-
-		if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated(
-				m_unObjectId,
-				pose,
-				sizeof(pose)
-			);
-		}
+		SubmitPose();
 	}
 };
 
@@ -740,6 +573,7 @@ enum HobovrTrackingRef_Msg_type
 	Emsg_distortion = 40,
 	Emsg_eyeGap = 50,
 	Emsg_setSelfPose = 60,
+	Emsg_calibration = 70,
 };
 
 enum HobovrVendorEvents
@@ -926,6 +760,44 @@ public:
 				break;
 			}
 
+			case Emsg_calibration: {
+				// data[1] is the udu index of the device or 0xFFFFFFFF for the default,
+				// then signed numerator/denominator pairs of qw qx qy qz tx ty tz scale,
+				// then the signed 1 based source axis of every world axis
+				int32_t* sdata = (int32_t*)buff;
+				hobovr::HobovrCalibration_t cal;
+				float v[8];
+				for (int i=0; i<8; i++)
+					v[i] = (float)sdata[2+i*2]/(float)sdata[3+i*2];
+
+				std::copy(v, v+4, cal.rot);
+				std::copy(v+4, v+7, cal.trans);
+				cal.scale = v[7];
+				std::copy(sdata+18, sdata+21, cal.axes);
+
+				if (!hobovr::ValidateCalibration(cal)) {
+					m_pSocketComm->send2("-100");
+					DriverLog("tracking reference: calibration change request rejected, invalid transform");
+					break;
+				}
+
+				char key[32];
+				if (data[1] == 0xFFFFFFFF)
+					snprintf(key, sizeof(key), "%s", hobovr::k_pch_Calibration_Default_String);
+				else
+					snprintf(key, sizeof(key), hobovr::k_pch_Calibration_DeviceKeyFormat, data[1]);
+
+				vr::VRSettings()->SetString(
+					hobovr::k_pch_Calibration_Section,
+					key,
+					hobovr::FormatCalibration(cal).c_str()
+				);
+
+				m_pSocketComm->send2("2000");
+				DriverLog("tracking reference: calibration change request processed");
+				break;
+			}
+
 			default:
 				DriverLog("tracking reference: message not recognized");
 				m_pSocketComm->send2("-100");
@@ -1081,8 +953,14 @@ public:
 
 		if (unResponseBufferSize >= 1)
 			pchResponseBuffer[0] = 0;
+
+		// pose stage timing since the last request, needs PoseStageTimers on
+		if (!strcmp(pchRequest, "stats") && m_pPosePipeline != nullptr && unResponseBufferSize >= 1)
+			m_pPosePipeline->FormatTimers(pchResponseBuffer, unResponseBufferSize);
 	}
 
+	void SetPosePipeline(hobovr::HobovrPosePipeline* pPosePipeline) {m_pPosePipeline = pPosePipeline;}
+
 	vr::DriverPose_t GetPose() {return m_Pose;}
 
 	std::string GetSerialNumber() const { return m_sSerialNumber;}
@@ -1110,6 +988,7 @@ private:
   std::string m_sSerialNumber; // steamvr uses this to identify devices, no need for you to touch this after init
   std::string m_sModelNumber; // steamvr uses this to identify devices, no need for you to touch this after init
 
+  hobovr::HobovrPosePipeline* m_pPosePipeline = nullptr; // owned by the server driver
 };
 
 
@@ -1129,6 +1008,52 @@ struct HobovrDeviceStorageNode_t {
 	void* handle;
 };
 
+// calls f with the device cast to its own class, f is a generic lambda, e.g. [&](auto* device) {device->SubmitPose();}
+// the device classes only share a templated base, so this is the one place that switches on the type
+template <typename F>
+inline void VisitDevice(const HobovrDeviceStorageNode_t& d, F&& f) {
+	switch (d.type) {
+		case EHobovrDeviceNodeTypes::hmd:
+			f((HeadsetDriver*)d.handle);
+			break;
+
+		case EHobovrDeviceNodeTypes::controller:
+			f((ControllerDriver*)d.handle);
+			break;
+
+		case EHobovrDeviceNodeTypes::tracker:
+			f((TrackerDriver*)d.handle);
+			break;
+	}
+}
+
+// everything the driver wide settings set, read on the RunFrame thread and applied between frames
+struct HobovrDriverSettings_t {
+	float fMaxLinVel = 0.f;
+	float fMaxAngVel = 0.f;
+	hobovr::HobovrCalibration_t vCalibration[hobovr::k_unMaxHotStateDevices]; // per udu index
+	float fVsyncToPhotons = 0.f;
+	float fDisplayFrequency = 0.f;
+	hobovr::HobovrPipelineConfig_t vPipeline[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrOutlierParams_t vOutlierParams[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrFilterParams_t vFilterParams[3] = {}; // per EHobovrDeviceNodeTypes
+	bool vbVelocityEstimate[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrPredictionParams_t vPredictionParams[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrWatchdogParams_t vWatchdogParams[3] = {}; // per EHobovrDeviceNodeTypes
+	float vfMaxSubmitRate[3] = {}; // per EHobovrDeviceNodeTypes
+	std::vector<std::pair<std::string, float>> vSubmitRateOverrides; // per serial, active and standby devices that have one
+	uint32_t unParallelMinDevices = 16;
+	bool bPoseStageTimers = false;
+	hobovr::HobovrNeckModelParams_t neckModelParams = {};
+	hobovr::HobovrImuNoise_t imuNoise = {};
+	bool bUpsample = false;
+	float fUpsampleRate = 100.f;
+	float fUpsampleLatency = 0.f;
+	float fUpsampleMaxExtrapolation = 0.f;
+	bool bVsyncSubmit = false;
+	float fVsyncMargin = 0.001f;
+};
+
 
 class CServerDriver_hobovr : public IServerTrackedDeviceProvider, public SockReceiver::Callback {
 public:
@@ -1147,12 +1072,33 @@ public:
 	void OnPacket(char* buff, int len);
 
 private:
+	void OnInputEvents(const char* buff, int len, uint32_t deviceCount);
+	void OnImuFrame(const char* buff, int len, uint32_t deviceCount);
+	void RunPoseStages(uint32_t deviceCount);
+	void RunPoseStageRange(uint32_t begin, uint32_t end, double now);
+
 	void SlowUpdateThread();
 	static void SlowUpdateThreadEnter(CServerDriver_hobovr *ptr) {
 		ptr->SlowUpdateThread();
 	}
 
+	void PacedThread();
+	static void PacedThreadEnter(CServerDriver_hobovr *ptr) {
+		ptr->PacedThread();
+	}
+
 	void UpdateServerDeviceList();
+	void AttachDevicesToHotState(const bool* vbKeepSlot = nullptr);
+	HobovrDeviceStorageNode_t CreateDevice(EHobovrDeviceNodeTypes type, const std::string& serial, int controllerHand);
+	static std::string GetDeviceSerialNumber(const HobovrDeviceStorageNode_t& d);
+	void SetDevicesPosePaced(bool bPaced);
+	void ApplySubmitRateLimits();
+	static void ReadSubmitRateOverride(const HobovrDeviceStorageNode_t& d, std::vector<std::pair<std::string, float>>& out);
+	void UpdateVsyncTiming();
+	void UpdateSectionSettings();
+	void ReadSectionSettings(HobovrDriverSettings_t& out);
+	void ApplySectionSettings(const HobovrDriverSettings_t& settings);
+	void ApplyPendingSettings();
 
 	std::vector<HobovrDeviceStorageNode_t> m_vDevices;
 	std::vector<HobovrDeviceStorageNode_t> m_vStandbyDevices;
@@ -1160,8 +1106,67 @@ private:
 	std::shared_ptr<SockReceiver::DriverReceiver> m_pSocketComm;
 	std::shared_ptr<HobovrTrackingRef_SettManager> m_pSettManTref;
 
-	bool m_bDeviceListSyncEvent = false;
-
+	std::mutex m_FrameMutex; // held by the receiver thread for a whole frame, udu changes take it to publish a new device list
+
+	// settings changes wait here until the receiver thread is between two frames, see UpdateSectionSettings()
+	std::mutex m_PendingSettingsMutex;
+	HobovrDriverSettings_t m_PendingSettings;
+	std::atomic<bool> m_bSettingsPending{false};
+
+	// per frame state of all active devices, device i in m_vDevices uses slot i
+	hobovr::HobovrHotState_t m_HotState;
+	hobovr::HobovrPoseValidator m_PoseValidator;
+	hobovr::HobovrCalibrationStage m_Calibration;
+	hobovr::HobovrOutlierGate m_OutlierGate;
+	hobovr::HobovrVelocityEstimator m_VelocityEstimator;
+	hobovr::HobovrOneEuroFilter m_JitterFilter;
+	hobovr::HobovrNeckModel m_NeckModel;
+	hobovr::HobovrPosePredictor m_PosePredictor;
+	hobovr::HobovrPosePipeline m_PosePipeline; // order of the stages above per device class
+	hobovr::HobovrOutlierParams_t m_vOutlierParams[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrFilterParams_t m_vFilterParams[3] = {}; // per EHobovrDeviceNodeTypes
+	bool m_vbVelocityEstimate[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrPredictionParams_t m_vPredictionParams[3] = {}; // per EHobovrDeviceNodeTypes
+	hobovr::HobovrNeckModelParams_t m_NeckModelParams = {}; // hmds only
+	// splits the pose stages over slots for large udu lists
+	// chunks are a cache line of floats so no two threads ever write the same line of the hot state
+	static const uint32_t k_unPipelineGrain = 16;
+	hobovr::HobovrWorkPool m_WorkPool;
+	uint32_t m_unParallelMinDevices = 16;
+
+	hobovr::HobovrDeviceStats_t m_vLastLoggedStats[hobovr::k_unMaxHotStateDevices] = {};
+	float m_vCompactRecords[hobovr::k_unMaxHotStateDevices * hobovr::k_iControllerPacketSize]; // compact frames get expanded here
+
+	// devices streaming imu frames get their pose from here
+	hobovr::HobovrImuFusion m_ImuFusion;
+	hobovr::HobovrImuSample_t m_vImuSamples[hobovr::k_unMaxImuSamplesPerFrame];
+
+	// upsampling, poses get resampled into m_PacedState and submitted at m_fUpsampleRate by the paced thread
+	hobovr::HobovrPoseUpsampler m_PoseUpsampler;
+	hobovr::HobovrHotState_t m_PacedState;
+	bool m_bUpsample = false;
+	float m_fUpsampleRate = 100.f;
+	float m_fUpsampleLatency = 0.f;
+	// stalled streams, checked by the paced thread at m_fUpsampleRate
+	hobovr::HobovrStreamWatchdog m_Watchdog;
+	hobovr::HobovrWatchdogParams_t m_vWatchdogParams[3] = {}; // per EHobovrDeviceNodeTypes
+	bool m_bWatchdog = false; // on for any device class
+	bool m_vbWatchdogBridging[hobovr::k_unMaxHotStateDevices] = {}; // paced thread only, counts each stall once
+	// submission rate caps, held back poses are flushed by the paced thread
+	hobovr::HobovrRateLimiter m_RateLimiter;
+	float m_vfMaxSubmitRate[3] = {}; // per EHobovrDeviceNodeTypes, Hz, 0 for no limit
+	std::vector<std::pair<std::string, float>> m_vSubmitRateOverrides; // per serial, Hz, they win over the class limit
+	bool m_bRateLimit = false; // on for any device
+	// vsync aligned submission, the paced thread submits the freshest poses margin before every compositor pose read
+	hobovr::HobovrVsyncScheduler m_VsyncScheduler;
+	bool m_bVsyncSubmit = false;
+	double m_fVsyncTimingPollTime = 0.0; // paced thread only, last time the compositor's frame timing was read
+	static constexpr double k_fVsyncTimingPollSeconds = 1.0; // the phase only drifts with the clocks
+
+	std::mutex m_DeviceListMutex; // held by the paced and slow update threads while they run, by udu changes while they publish m_vDevices and while settings are applied, after m_FrameMutex
+
+	bool m_bPacedThreadIsAlive;
+	std::thread* m_ptPacedThread;
 
 	// slower thread stuff
 	bool m_bSlowUpdateThreadIsAlive;
@@ -1191,6 +1196,13 @@ EVRInitError CServerDriver_hobovr::Init(vr::IVRDriverContext *pDriverContext) {
 	uduThing = buf;
 	DriverLog("driver: udu settings: '%s'\n", uduThing.c_str());
 
+	// nothing else runs yet
+	{
+		HobovrDriverSettings_t settings;
+		ReadSectionSettings(settings);
+		ApplySectionSettings(settings);
+	}
+
 	// udu setting parse is done by SockReceiver
 	try{
 		m_pSocketComm = std::make_shared<SockReceiver::DriverReceiver>(uduThing);
@@ -1204,58 +1216,32 @@ EVRInitError CServerDriver_hobovr::Init(vr::IVRDriverContext *pDriverContext) {
 
 	}
 
+	if (m_pSocketComm->m_vsDevice_list.size() > hobovr::k_unMaxHotStateDevices) {
+		DriverLog("driver: too many udu devices, %d given, %d max", (int)m_pSocketComm->m_vsDevice_list.size(), (int)hobovr::k_unMaxHotStateDevices);
+		return VRInitError_VendorSpecific_HmdFound_ConfigFailedSanityCheck;
+	}
+
 	int counter_hmd = 0;
 	int counter_cntrlr = 0;
 	int counter_trkr = 0;
 	int controller_hs = 1;
 
+	m_vDevices.reserve(hobovr::k_unMaxHotStateDevices);
+	m_vStandbyDevices.reserve(hobovr::k_unMaxHotStateDevices);
+
 	// add new devices based on the udu parse 
 	for (std::string i:m_pSocketComm->m_vsDevice_list) {
 		if (i == "h") {
-			HeadsetDriver* temp = new HeadsetDriver(
-				"h" + std::to_string(counter_hmd)
-			);
-
-			vr::VRServerDriverHost()->TrackedDeviceAdded(
-				temp->GetSerialNumber().c_str(),
-				vr::TrackedDeviceClass_HMD,
-				temp
-			);
-
-			m_vDevices.push_back({EHobovrDeviceNodeTypes::hmd, temp});
-
-		  counter_hmd++;
+			m_vDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::hmd, "h" + std::to_string(counter_hmd), 0));
+			counter_hmd++;
 
 		} else if (i == "c") {
-			ControllerDriver* temp = new ControllerDriver(
-				controller_hs,
-				"c" + std::to_string(counter_cntrlr),
-				m_pSocketComm
-			);
-
-			vr::VRServerDriverHost()->TrackedDeviceAdded(
-						temp->GetSerialNumber().c_str(),
-						vr::TrackedDeviceClass_Controller,
-						temp);
-			m_vDevices.push_back({EHobovrDeviceNodeTypes::controller, temp});
-
+			m_vDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::controller, "c" + std::to_string(counter_cntrlr), controller_hs));
 			controller_hs = (controller_hs) ? 0 : 1;
 			counter_cntrlr++;
 
 		} else if (i == "t") {
-			TrackerDriver* temp = new TrackerDriver(
-				"t" + std::to_string(counter_trkr),
-				m_pSocketComm
-			);
-
-			vr::VRServerDriverHost()->TrackedDeviceAdded(
-				temp->GetSerialNumber().c_str(),
-				vr::TrackedDeviceClass_GenericTracker,
-				temp
-			);
-
-			m_vDevices.push_back({EHobovrDeviceNodeTypes::tracker, temp});
-
+			m_vDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::tracker, "t" + std::to_string(counter_trkr), 0));
 			counter_trkr++;
 
 		} else {
@@ -1264,6 +1250,40 @@ EVRInitError CServerDriver_hobovr::Init(vr::IVRDriverContext *pDriverContext) {
 		}
 	}
 
+	// device pool, spares on top of the udu list with the serials it would give next, parked in standby until a udu change asks for them
+	// they are registered but never reported connected, so they stay hidden
+	int poolHmds = std::min(vr::VRSettings()->GetInt32(k_pch_Hobovr_Section, k_pch_Hobovr_DevicePoolHmds_Int32), 1);
+	int poolControllers = vr::VRSettings()->GetInt32(k_pch_Hobovr_Section, k_pch_Hobovr_DevicePoolControllers_Int32);
+	int poolTrackers = vr::VRSettings()->GetInt32(k_pch_Hobovr_Section, k_pch_Hobovr_DevicePoolTrackers_Int32);
+
+	for (int k = 0; k < poolHmds && counter_hmd < 1; k++, counter_hmd++)
+		m_vStandbyDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::hmd, "h" + std::to_string(counter_hmd), 0));
+
+	for (int k = 0; k < poolControllers && m_vDevices.size() + m_vStandbyDevices.size() < hobovr::k_unMaxHotStateDevices; k++, counter_cntrlr++)
+		m_vStandbyDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::controller, "c" + std::to_string(counter_cntrlr), (counter_cntrlr % 2) ? 0 : 1));
+
+	for (int k = 0; k < poolTrackers && m_vDevices.size() + m_vStandbyDevices.size() < hobovr::k_unMaxHotStateDevices; k++, counter_trkr++)
+		m_vStandbyDevices.push_back(CreateDevice(EHobovrDeviceNodeTypes::tracker, "t" + std::to_string(counter_trkr), 0));
+
+	DriverLog("driver: device pool: %d standby devices", (int)m_vStandbyDevices.size());
+
+	// the settings were read before there were any devices
+	for (auto& i : m_vDevices)
+		ReadSubmitRateOverride(i, m_vSubmitRateOverrides);
+
+	for (auto& i : m_vStandbyDevices)
+		ReadSubmitRateOverride(i, m_vSubmitRateOverrides);
+
+	AttachDevicesToHotState();
+
+	// pose pipeline workers, only used for large udu lists
+	int iPipelineThreads = vr::VRSettings()->GetInt32(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_PipelineThreads_Int32);
+	if (iPipelineThreads <= 0)
+		iPipelineThreads = (int)std::min(std::thread::hardware_concurrency() / 2, 4u);
+
+	m_WorkPool.Start((uint32_t)iPipelineThreads);
+	DriverLog("driver: pose pipeline workers: %d\n", (int)m_WorkPool.GetWorkerCount());
+
 	// start listening for device data
 	m_pSocketComm->setCallback(this);
 
@@ -1275,8 +1295,13 @@ EVRInitError CServerDriver_hobovr::Init(vr::IVRDriverContext *pDriverContext) {
 		return VRInitError_IPC_Failed;
 	}
 
+	// pose upsampling and watchdog thread, idles while both are off
+	m_bPacedThreadIsAlive = true;
+	m_ptPacedThread = new std::thread(this->PacedThreadEnter, this);
+
 	// settings manager
 	m_pSettManTref = std::make_shared<HobovrTrackingRef_SettManager>("trsm0");
+	m_pSettManTref->SetPosePipeline(&m_PosePipeline);
 	vr::VRServerDriverHost()->TrackedDeviceAdded(
 		m_pSettManTref->GetSerialNumber().c_str(),
 		vr::TrackedDeviceClass_TrackingReference,
@@ -1293,49 +1318,20 @@ void CServerDriver_hobovr::Cleanup() {
 	m_pSocketComm->stop();
 	m_bSlowUpdateThreadIsAlive = false;
 	m_ptSlowUpdateThread->join();
+	m_bPacedThreadIsAlive = false;
+	m_ptPacedThread->join();
+	m_WorkPool.Stop();
 
 	for (auto& i : m_vDevices) {
-		switch (i.type) {
-			case EHobovrDeviceNodeTypes::hmd: {
-				HeadsetDriver* device = (HeadsetDriver*)i.handle;
-				free(device);
-				break;
-			}
-
-			case EHobovrDeviceNodeTypes::controller: {
-				ControllerDriver* device = (ControllerDriver*)i.handle;
-				free(device);
-				break;
-			}
-
-			case EHobovrDeviceNodeTypes::tracker: {
-				TrackerDriver* device = (TrackerDriver*)i.handle;
-				free(device);
-				break;
-			}
-		}
+		VisitDevice(i, [&](auto* device) {
+			delete device;
+		});
 	}
 
 	for (auto& i : m_vStandbyDevices) {
-		switch (i.type) {
-			case EHobovrDeviceNodeTypes::hmd: {
-				HeadsetDriver* device = (HeadsetDriver*)i.handle;
-				free(device);
-				break;
-			}
-
-			case EHobovrDeviceNodeTypes::controller: {
-				ControllerDriver* device = (ControllerDriver*)i.handle;
-				free(device);
-				break;
-			}
-
-			case EHobovrDeviceNodeTypes::tracker: {
-				TrackerDriver* device = (TrackerDriver*)i.handle;
-				free(device);
-				break;
-			}
-		}
+		VisitDevice(i, [&](auto* device) {
+			delete device;
+		});
 	}
 
 	m_vDevices.clear();
@@ -1346,264 +1342,919 @@ void CServerDriver_hobovr::Cleanup() {
 }
 
 void CServerDriver_hobovr::OnPacket(char* buff, int len) {
-  if (len == (m_pSocketComm->m_iExpectedMessageSize*4+3) && !m_bDeviceListSyncEvent)
+  std::lock_guard<std::mutex> frameLock(m_FrameMutex);
+
+  if (m_bSettingsPending)
+	ApplyPendingSettings();
+
+  uint32_t deviceCount = std::min(m_HotState.count, (uint32_t)m_pSocketComm->m_viEps.size());
+  const float* records[hobovr::k_unMaxHotStateDevices];
+  hobovr::HobovrAddressedRecordHeader_t recordHeaders[hobovr::k_unMaxHotStateDevices];
+  bool bDecoded = false;
+  bool bAddressed = false;
+  double frameAge = 0.0; // sparse frames only
+  uint32_t magic = hobovr::GetFrameMagic(buff, len);
+
+  if (magic == hobovr::k_unFrameMagic_InputEvents) {
+	OnInputEvents(buff, len, deviceCount);
+	return;
+  }
+
+  if (magic == hobovr::k_unFrameMagic_Imu) {
+	OnImuFrame(buff, len, deviceCount);
+	return;
+  }
+
+  switch (magic) {
+	case hobovr::k_unFrameMagic_Sparse:
+		bDecoded = hobovr::DecodeSparseFrame(buff, len, m_pSocketComm->m_viEps, deviceCount, records, frameAge);
+		break;
+
+	case hobovr::k_unFrameMagic_Compact:
+		bDecoded = hobovr::DecodeCompactFrame(
+			buff,
+			len,
+			m_pSocketComm->m_vsDevice_list,
+			m_pSocketComm->m_viEps,
+			deviceCount,
+			m_vCompactRecords,
+			hobovr::k_iControllerPacketSize,
+			records
+		);
+		break;
+
+	case hobovr::k_unFrameMagic_Addressed:
+		bDecoded = hobovr::DecodeAddressedFrame(buff, len, m_pSocketComm->m_viEps, deviceCount, records, recordHeaders);
+		bAddressed = true;
+		break;
+
+	default:
+		bDecoded = hobovr::DecodeDenseFrame(buff, len, m_pSocketComm->m_viEps, deviceCount, records);
+  }
+
+  if (bDecoded)
   {
-	float* temp= (float*)buff;
-	std::vector<float> v(temp, temp+m_pSocketComm->m_iExpectedMessageSize);
-	auto tempPose = SockReceiver::split_pk(v, m_pSocketComm->m_viEps);
-
-	for (size_t i=0; i < m_vDevices.size(); i++){
-		switch (m_vDevices[i].type) {
-			case EHobovrDeviceNodeTypes::hmd: {
-				HeadsetDriver* device = (HeadsetDriver*)m_vDevices[i].handle;
-				device->RunFrame(tempPose[i]);
+	double sampleTime = hobovr::ToSteadySeconds(m_pSocketComm->m_tLastPacketTime);
+
+	// decode the frame into the hot state table
+	for (uint32_t i=0; i < deviceCount; i++) {
+		if (records[i] == nullptr || m_pSocketComm->m_viEps[i] < hobovr::k_iPosePacketSize)
+			continue;
+
+		if (m_ImuFusion.IsActive(i, sampleTime)) {
+			// the pose comes from the imu fusion, the record is only good for inputs
+			if (m_vDevices[i].type == EHobovrDeviceNodeTypes::controller)
+				((ControllerDriver*)m_vDevices[i].handle)->UpdateInputs(records[i]);
+
+			continue;
+		}
+
+		if (!bAddressed) {
+			hobovr::HotStateStorePacket(m_HotState, i, records[i], sampleTime - frameAge, frameAge > 0.0);
+
+		} else if (hobovr::HotStateAcceptSequence(m_HotState, i, recordHeaders[i].sequence)) {
+			double sampleAge = hobovr::AddressedSampleAge(recordHeaders[i]);
+			hobovr::HotStateStorePacket(m_HotState, i, records[i], sampleTime - sampleAge, sampleAge > 0.0);
+		}
+	}
+
+	RunPoseStages(deviceCount);
+
+	// submit, rate limited devices still get their inputs every frame
+	double submitTime = hobovr::GetSteadySeconds();
+	for (uint32_t i=0; i < deviceCount; i++){
+		if (!(m_HotState.flags[i] & hobovr::EHotState_Updated))
+			continue;
+
+		if (!m_bUpsample && !m_bVsyncSubmit && !m_RateLimiter.Admit(m_HotState, i, submitTime)) {
+			if (m_vDevices[i].type == EHobovrDeviceNodeTypes::controller)
+				((ControllerDriver*)m_vDevices[i].handle)->UpdateInputs(records[i]);
+
+			m_HotState.flags[i] &= ~hobovr::EHotState_Updated;
+			continue;
+		}
+
+		VisitDevice(m_vDevices[i], [&](auto* device) {
+			device->RunFrame(records[i]);
+		});
+
+		m_HotState.flags[i] &= ~hobovr::EHotState_Updated;
+	}
+
+  } else if (magic == 0) {
+	DriverLog("driver: bad packet, dense frames should be %d long, got %d. double check your udu settings\n", (m_pSocketComm->m_iExpectedMessageSize*4+3), len);
+
+  } else {
+	DriverLog("driver: bad %s frame (magic 0x%08x), %d bytes, its decoder rejected it. double check your udu settings\n", hobovr::GetFrameName(magic), magic, len);
+  }
+
+
+}
+
+// every pose stage, in order, over the slots updated this frame
+// slots are independent, large udu lists get split over the work pool and are all done when this returns
+void CServerDriver_hobovr::RunPoseStages(uint32_t deviceCount) {
+	double now = hobovr::GetSteadySeconds();
+
+	if (deviceCount < m_unParallelMinDevices) {
+		RunPoseStageRange(0, deviceCount, now);
+		return;
+	}
+
+	m_WorkPool.ParallelFor(deviceCount, k_unPipelineGrain, [this, now](uint32_t begin, uint32_t end) {
+		RunPoseStageRange(begin, end, now);
+	});
+}
+
+// the configured stages of every slot's class, then the consumers of the pipeline output
+void CServerDriver_hobovr::RunPoseStageRange(uint32_t begin, uint32_t end, double now) {
+	m_PosePipeline.Run(begin, end, [this, now](hobovr::EHobovrPoseStage stage, uint32_t b, uint32_t e) {
+		switch (stage) {
+			case hobovr::EPoseStage_Validate:
+				m_PoseValidator.Run(m_HotState, b, e);
 				break;
-			}
 
-			case EHobovrDeviceNodeTypes::controller: {
-				ControllerDriver* device = (ControllerDriver*)m_vDevices[i].handle;
-				device->RunFrame(tempPose[i]);
+			case hobovr::EPoseStage_Calibrate:
+				m_Calibration.Run(m_HotState, b, e);
 				break;
-			}
 
-			case EHobovrDeviceNodeTypes::tracker: {
-				TrackerDriver* device = (TrackerDriver*)m_vDevices[i].handle;
-				device->RunFrame(tempPose[i]);
+			case hobovr::EPoseStage_Outlier:
+				m_OutlierGate.Run(m_HotState, b, e);
+				break;
+
+			case hobovr::EPoseStage_Velocity:
+				m_VelocityEstimator.Run(m_HotState, b, e);
+				break;
+
+			case hobovr::EPoseStage_Filter:
+				m_JitterFilter.Run(m_HotState, b, e);
+				break;
+
+			case hobovr::EPoseStage_Neck:
+				m_NeckModel.Run(m_HotState, b, e);
+				break;
+
+			case hobovr::EPoseStage_Predict:
+				m_PosePredictor.Run(m_HotState, b, e, now);
+				break;
+
+			default:
 				break;
-			}
 		}
+	});
+
+	if (m_bUpsample)
+		m_PoseUpsampler.Push(m_HotState, begin, end);
+
+	if (m_bVsyncSubmit)
+		m_VsyncScheduler.Push(m_HotState, begin, end);
+
+	m_Watchdog.Push(m_HotState, begin, end, now);
+}
+
+void CServerDriver_hobovr::OnImuFrame(const char* buff, int len, uint32_t deviceCount) {
+  uint32_t sampleCount = 0;
+
+  if (!hobovr::DecodeImuFrame(buff, len, m_vImuSamples, hobovr::k_unMaxImuSamplesPerFrame, sampleCount)) {
+	DriverLog("driver: bad imu frame, %d bytes\n", len);
+	return;
+  }
 
+  m_ImuFusion.Process(m_vImuSamples, sampleCount, deviceCount, hobovr::ToSteadySeconds(m_pSocketComm->m_tLastPacketTime), m_HotState);
+  RunPoseStages(deviceCount);
+
+  // poses only, inputs keep coming from pose records or input events
+  double submitTime = hobovr::GetSteadySeconds();
+  for (uint32_t i=0; i < deviceCount; i++) {
+	if (!(m_HotState.flags[i] & hobovr::EHotState_Updated))
+		continue;
+
+	if (!m_bUpsample && !m_bVsyncSubmit && !m_RateLimiter.Admit(m_HotState, i, submitTime)) {
+		m_HotState.flags[i] &= ~hobovr::EHotState_Updated;
+		continue;
 	}
 
-  } else {
-	DriverLog("driver: bad packet, expected %d, got %d. double check your udu settings\n", (m_pSocketComm->m_iExpectedMessageSize*4+3), len);
+	VisitDevice(m_vDevices[i], [&](auto* device) {
+		device->SubmitPose();
+	});
+
+	m_HotState.flags[i] &= ~hobovr::EHotState_Updated;
+  }
+}
+
+void CServerDriver_hobovr::OnInputEvents(const char* buff, int len, uint32_t deviceCount) {
+  hobovr::HobovrInputEvent_t events[hobovr::k_unMaxInputEventsPerFrame];
+  uint32_t eventCount = 0;
+
+  if (!hobovr::DecodeInputEventFrame(buff, len, events, hobovr::k_unMaxInputEventsPerFrame, eventCount)) {
+	DriverLog("driver: bad input event frame, %d bytes\n", len);
+	return;
   }
 
+  // events are forwarded right away, their age is counted from when the frame arrived
+  double arrivalAge = hobovr::GetSteadySeconds() - hobovr::ToSteadySeconds(m_pSocketComm->m_tLastPacketTime);
+
+  for (uint32_t i=0; i < eventCount; i++) {
+	const hobovr::HobovrInputEvent_t& event = events[i];
+	if (event.device >= deviceCount || m_vDevices[event.device].type != EHobovrDeviceNodeTypes::controller)
+		continue;
 
+	ControllerDriver* device = (ControllerDriver*)m_vDevices[event.device].handle;
+	device->ProcessInputEvent(event, -(hobovr::InputEventAge(event) + arrivalAge));
+  }
 }
 
 void CServerDriver_hobovr::RunFrame() {
 	vr::VREvent_t vrEvent;
 	while (vr::VRServerDriverHost()->PollNextEvent(&vrEvent, sizeof(vrEvent))) {
 		for (auto& i : m_vDevices) {
-			switch (i.type) {
-				case EHobovrDeviceNodeTypes::hmd: {
-					HeadsetDriver* device = (HeadsetDriver*)i.handle;
-					device->ProcessEvent(vrEvent);
-					break;
-				}
-
-				case EHobovrDeviceNodeTypes::controller: {
-					ControllerDriver* device = (ControllerDriver*)i.handle;
-					device->ProcessEvent(vrEvent);
-					break;
-				}
+			VisitDevice(i, [&](auto* device) {
+				device->ProcessEvent(vrEvent);
+			});
+		}
 
-				case EHobovrDeviceNodeTypes::tracker: {
-					TrackerDriver* device = (TrackerDriver*)i.handle;
+		if (vrEvent.eventType == vr::VREvent_OtherSectionSettingChanged) {
+			// standby devices too, pooled ones have to be current when they get picked
+			for (auto& i : m_vStandbyDevices) {
+				VisitDevice(i, [&](auto* device) {
 					device->ProcessEvent(vrEvent);
-					break;
-				}
+				});
 			}
+
+			UpdateSectionSettings();
 		}
 
 		if (vrEvent.eventType == HobovrVendorEvents::UduChange) {
 			DriverLog("udu change event");
-			std::vector<std::string> newD;
-			std::vector<int> newEps;
-			auto uduBufferCopy = g_vpUduChangeBuffer;
 
-			for (auto i : uduBufferCopy) {
+			for (auto i : g_vpUduChangeBuffer)
 				DriverLog("pair: (%s, %d)", i.first.c_str(), i.second);
-				newD.push_back(i.first);
-				newEps.push_back(i.second);
-			}
 
-			m_bDeviceListSyncEvent = true;
-			m_pSocketComm->UpdateParams(newD, newEps);
 			UpdateServerDeviceList();
-			m_bDeviceListSyncEvent = false;
 		}
 	}
 }
 
+// diffs the new udu list against the active devices, only the difference gets touched
+// devices that stay keep streaming, ones that stay in the same slot keep their pipeline state too
+// removed devices go to standby, added ones come back from standby or get created
+// the new list is built on the side and published under m_FrameMutex and m_DeviceListMutex together with the receiver's udu params,
+// so no frame, paced tick or stats pass ever sees a list that doesn't match the hot state
+// the receiver's udu params are built from the same checked and truncated list, so slot n is always udu record n
 void CServerDriver_hobovr::UpdateServerDeviceList() {
-	for (auto i : m_vDevices) {
-		switch (i.type) {
-			case EHobovrDeviceNodeTypes::hmd: {
-				HeadsetDriver* device = (HeadsetDriver*)i.handle;
-				device->PowerOff();
-				break;
-			}
-
-			case EHobovrDeviceNodeTypes::controller: {
-				ControllerDriver* device = (ControllerDriver*)i.handle;
-				device->PowerOff();
-				break;
-			}
+	auto uduBufferCopy = g_vpUduChangeBuffer;
+	g_vpUduChangeBuffer.clear();
 
-			case EHobovrDeviceNodeTypes::tracker: {
-				TrackerDriver* device = (TrackerDriver*)i.handle;
-				device->PowerOff();
-				break;
-			}
-		}
-		m_vStandbyDevices.push_back(i);
+	if (uduBufferCopy.size() > hobovr::k_unMaxHotStateDevices) {
+		DriverLog("driver: too many udu devices, %d given, only the first %d will be used", (int)uduBufferCopy.size(), (int)hobovr::k_unMaxHotStateDevices);
+		uduBufferCopy.resize(hobovr::k_unMaxHotStateDevices);
 	}
 
-	m_vDevices.clear();
-
-	auto uduBufferCopy = g_vpUduChangeBuffer;
-
+	// serials of the new list, numbered per device class in udu order
+	std::vector<std::pair<EHobovrDeviceNodeTypes, std::string>> wanted;
+	std::vector<std::string> vsDeviceList;
+	std::vector<int> viEps;
 	int counter_hmd = 0;
 	int counter_cntrlr = 0;
 	int counter_trkr = 0;
-	int controller_hs = 1;
 
 	for (auto i : uduBufferCopy) {
-		if (i.first == "h") {
-			auto target = "h" + std::to_string(counter_hmd);
-			auto key = [target](HobovrDeviceStorageNode_t d)->bool {
-				switch (d.type) {
-					case EHobovrDeviceNodeTypes::hmd:
-						return ((HeadsetDriver*)d.handle)->GetSerialNumber() == target;
-
-					case EHobovrDeviceNodeTypes::controller:
-						return ((ControllerDriver*)d.handle)->GetSerialNumber() == target;
-
-					case EHobovrDeviceNodeTypes::tracker:
-						return ((TrackerDriver*)d.handle)->GetSerialNumber() == target;
+		if (i.first == "h")
+			wanted.push_back({EHobovrDeviceNodeTypes::hmd, "h" + std::to_string(counter_hmd++)});
+		else if (i.first == "c")
+			wanted.push_back({EHobovrDeviceNodeTypes::controller, "c" + std::to_string(counter_cntrlr++)});
+		else if (i.first == "t")
+			wanted.push_back({EHobovrDeviceNodeTypes::tracker, "t" + std::to_string(counter_trkr++)});
+		else {
+			// skipping it would shift every following record onto the wrong slot, so the whole string goes
+			DriverLog("driver: udu change: unknown device type in record %d, udu string rejected", (int)vsDeviceList.size());
+			return;
+		}
+
+		vsDeviceList.push_back(i.first);
+		viEps.push_back(i.second);
+	}
+
+	// unchanged and added, in udu order
+	std::vector<HobovrDeviceStorageNode_t> newDevices;
+	std::vector<std::pair<std::string, float>> newOverrides; // of constructed devices, the settings only had the pooled ones
+	bool vbKeepSlot[hobovr::k_unMaxHotStateDevices] = {};
+	int controller_hs = 1;
+	uint32_t kept = 0;
+
+	for (uint32_t n = 0; n < wanted.size(); n++) {
+		EHobovrDeviceNodeTypes type = wanted[n].first;
+		const std::string& target = wanted[n].second;
+		auto key = [&](const HobovrDeviceStorageNode_t& d)->bool {
+			return d.type == type && GetDeviceSerialNumber(d) == target;
+		};
+
+		auto res = std::find_if(m_vDevices.begin(), m_vDevices.end(), key);
+		if (res != m_vDevices.end()) {
+			vbKeepSlot[n] = (uint32_t)(res - m_vDevices.begin()) == n;
+			newDevices.push_back(*res);
+			kept++;
+
+		} else if ((res = std::find_if(m_vStandbyDevices.begin(), m_vStandbyDevices.end(), key)) != m_vStandbyDevices.end()) {
+			VisitDevice(*res, [&](auto* device) {
+				device->PowerOn();
+			});
+
+			newDevices.push_back(*res);
+			m_vStandbyDevices.erase(res);
+
+		} else {
+			DriverLog("driver: udu change: '%s' isn't pooled, constructing it", target.c_str());
+			newDevices.push_back(CreateDevice(type, target, controller_hs));
+			ReadSubmitRateOverride(newDevices.back(), newOverrides);
+		}
+
+		if (type == EHobovrDeviceNodeTypes::controller)
+			controller_hs = (controller_hs) ? 0 : 1;
+	}
+
+	// removed
+	std::vector<HobovrDeviceStorageNode_t> removedDevices;
+	for (auto& i : m_vDevices) {
+		auto same = [&](const HobovrDeviceStorageNode_t& d)->bool {
+			return d.handle == i.handle;
+		};
+
+		if (std::find_if(newDevices.begin(), newDevices.end(), same) == newDevices.end())
+			removedDevices.push_back(i);
+	}
+
+	DriverLog("driver: udu change: %u kept, %u added, %u removed", kept, (uint32_t)newDevices.size() - kept, (uint32_t)removedDevices.size());
+
+	{
+		// publish, the hot state is re-attached before any other thread gets back in
+		std::lock_guard<std::mutex> frameLock(m_FrameMutex);
+		std::lock_guard<std::mutex> lock(m_DeviceListMutex);
+
+		m_pSocketComm->UpdateParams(vsDeviceList, viEps);
+		m_vDevices.swap(newDevices);
+		m_vStandbyDevices.insert(m_vStandbyDevices.end(), removedDevices.begin(), removedDevices.end());
+		m_vSubmitRateOverrides.insert(m_vSubmitRateOverrides.end(), newOverrides.begin(), newOverrides.end());
+		AttachDevicesToHotState(vbKeepSlot);
+	}
+
+	// detached now, nothing submits for them anymore
+	for (auto& i : removedDevices) {
+		VisitDevice(i, [&](auto* device) {
+			device->PowerOff();
+		});
+	}
+}
+
+// constructs and registers a device, the allocation and the device's settings reads happen here
+// controllerHand is only used by controllers
+HobovrDeviceStorageNode_t CServerDriver_hobovr::CreateDevice(EHobovrDeviceNodeTypes type, const std::string& serial, int controllerHand) {
+	switch (type) {
+		case EHobovrDeviceNodeTypes::hmd: {
+			HeadsetDriver* temp = new HeadsetDriver(serial);
+
+			vr::VRServerDriverHost()->TrackedDeviceAdded(
+				temp->GetSerialNumber().c_str(),
+				vr::TrackedDeviceClass_HMD,
+				temp
+			);
+			return {EHobovrDeviceNodeTypes::hmd, temp};
+		}
+
+		case EHobovrDeviceNodeTypes::controller: {
+			ControllerDriver* temp = new ControllerDriver(
+				controllerHand,
+				serial,
+				m_pSocketComm,
+				&m_FrameMutex
+			);
+
+			vr::VRServerDriverHost()->TrackedDeviceAdded(
+				temp->GetSerialNumber().c_str(),
+				vr::TrackedDeviceClass_Controller,
+				temp
+			);
+			return {EHobovrDeviceNodeTypes::controller, temp};
+		}
+
+		case EHobovrDeviceNodeTypes::tracker:
+		default: {
+			TrackerDriver* temp = new TrackerDriver(serial, m_pSocketComm);
+
+			vr::VRServerDriverHost()->TrackedDeviceAdded(
+				temp->GetSerialNumber().c_str(),
+				vr::TrackedDeviceClass_GenericTracker,
+				temp
+			);
+			return {EHobovrDeviceNodeTypes::tracker, temp};
+		}
+	}
+}
+
+std::string CServerDriver_hobovr::GetDeviceSerialNumber(const HobovrDeviceStorageNode_t& d) {
+	std::string serial;
+	VisitDevice(d, [&](auto* device) {
+		serial = device->GetSerialNumber();
+	});
+	return serial;
+}
+
+// device i in m_vDevices gets hot state slot i, standby devices get none
+// slots flagged in vbKeepSlot hold the same device as before and keep their state, the rest start over
+void CServerDriver_hobovr::AttachDevicesToHotState(const bool* vbKeepSlot) {
+	for (auto& i : m_vStandbyDevices) {
+		VisitDevice(i, [&](auto* device) {
+			device->AttachHotState(nullptr, hobovr::k_unHotStateIndexInvalid);
+		});
+	}
+
+	for (uint32_t i = 0; i < m_HotState.count; i++) {
+		if (!vbKeepSlot || !vbKeepSlot[i])
+			hobovr::HotStateClearSlot(m_HotState, i);
+	}
+
+	hobovr::HotStateResize(m_HotState, (uint32_t)m_vDevices.size());
+
+	for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++) {
+		if (vbKeepSlot && vbKeepSlot[i])
+			continue;
+
+		m_PoseValidator.ResetSlot(i);
+		m_OutlierGate.ResetSlot(i);
+		m_VelocityEstimator.ResetSlot(i);
+		m_JitterFilter.ResetSlot(i);
+		m_PosePredictor.ResetSlot(i);
+		m_PoseUpsampler.ResetSlot(i);
+		m_Watchdog.ResetSlot(i);
+		m_RateLimiter.ResetSlot(i);
+		m_VsyncScheduler.ResetSlot(i);
+		m_ImuFusion.ResetSlot(i);
+		m_vLastLoggedStats[i] = {};
+	}
+
+	for (uint32_t i = 0; i < m_HotState.count; i++) {
+		m_PosePipeline.SetSlotClass(i, (uint32_t)m_vDevices[i].type);
+		m_OutlierGate.SetSlotParams(i, m_vOutlierParams[(int)m_vDevices[i].type]);
+		m_VelocityEstimator.SetSlotEnabled(i, m_vbVelocityEstimate[(int)m_vDevices[i].type]);
+		m_JitterFilter.SetSlotParams(i, m_vFilterParams[(int)m_vDevices[i].type]);
+		m_PosePredictor.SetSlotParams(i, m_vPredictionParams[(int)m_vDevices[i].type]);
+		m_Watchdog.SetSlotParams(i, m_vWatchdogParams[(int)m_vDevices[i].type]);
+		m_NeckModel.SetSlotParams(i, m_vDevices[i].type == EHobovrDeviceNodeTypes::hmd ? m_NeckModelParams : hobovr::HobovrNeckModelParams_t{});
+	}
+
+	for (uint32_t i = 0; i < m_HotState.count; i++) {
+		VisitDevice(m_vDevices[i], [&](auto* device) {
+			device->AttachHotState(&m_HotState, i);
+		});
+
+		if (m_vDevices[i].type == EHobovrDeviceNodeTypes::controller)
+			((ControllerDriver*)m_vDevices[i].handle)->BindInputRecordSize(i < m_pSocketComm->m_viEps.size() ? (uint32_t)m_pSocketComm->m_viEps[i] : 0u);
+	}
+
+	ApplySubmitRateLimits();
+	SetDevicesPosePaced(m_bUpsample || m_bVsyncSubmit);
+}
+
+// class limit, or the device's own "MaxSubmitRate_<serial>" override
+// no settings reads here, it runs with the receiver and the paced thread locked out
+void CServerDriver_hobovr::ApplySubmitRateLimits() {
+	bool bRateLimit = false;
+
+	for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++) {
+		if (i >= m_HotState.count || i >= m_vDevices.size()) {
+			m_RateLimiter.SetSlotMaxRate(i, 0.f);
+			continue;
+		}
+
+		std::string serial = GetDeviceSerialNumber(m_vDevices[i]);
+		float fRate = m_vfMaxSubmitRate[(int)m_vDevices[i].type];
+		for (auto& j : m_vSubmitRateOverrides) {
+			if (j.first == serial)
+				fRate = j.second;
+		}
+
+		m_RateLimiter.SetSlotMaxRate(i, fRate);
+		bRateLimit = bRateLimit || m_RateLimiter.IsLimited(i);
+	}
+
+	m_bRateLimit = bRateLimit;
+}
+
+// appends device d's "MaxSubmitRate_<serial>" from its class section if it has one
+void CServerDriver_hobovr::ReadSubmitRateOverride(const HobovrDeviceStorageNode_t& d, std::vector<std::pair<std::string, float>>& out) {
+	const char* const sections[3] = {k_pch_Hmd_Section, hobovr::k_pch_Controller_Section, k_pch_Tracker_Section};
+	std::string serial = GetDeviceSerialNumber(d);
+	std::string key = std::string(hobovr::k_pch_RateLimit_MaxSubmitRate_Float) + "_" + serial;
+	vr::EVRSettingsError err = vr::VRSettingsError_None;
+	float fRate = vr::VRSettings()->GetFloat(sections[(int)d.type], key.c_str(), &err);
+	if (err != vr::VRSettingsError_None)
+		return;
+
+	DriverLog("driver: device '%s' submit rate limit: %fHz", serial.c_str(), fRate);
+	out.push_back({serial, fRate});
+}
+
+void CServerDriver_hobovr::SetDevicesPosePaced(bool bPaced) {
+	for (auto& i : m_vDevices) {
+		VisitDevice(i, [&](auto* device) {
+			device->SetPosePaced(bPaced);
+		});
+	}
+}
+
+// driver wide settings, called on settings change
+// pipeline state belongs to the receiver thread, so the new values are only staged here and applied between two frames
+void CServerDriver_hobovr::UpdateSectionSettings() {
+	HobovrDriverSettings_t settings;
+	ReadSectionSettings(settings);
+
+	std::lock_guard<std::mutex> lock(m_PendingSettingsMutex);
+	m_PendingSettings = settings;
+	m_bSettingsPending = true;
+}
+
+// receiver thread, before a frame runs its pose stages
+void CServerDriver_hobovr::ApplyPendingSettings() {
+	HobovrDriverSettings_t settings;
+	{
+		std::lock_guard<std::mutex> lock(m_PendingSettingsMutex);
+		settings = m_PendingSettings;
+		m_bSettingsPending = false;
+	}
+
+	// the paced thread reads the upsampling, watchdog, rate limit and vsync state under this
+	std::lock_guard<std::mutex> lock(m_DeviceListMutex);
+	ApplySectionSettings(settings);
+	DriverLog("driver: settings applied");
+}
+
+// reads and logs everything, touches no live state
+void CServerDriver_hobovr::ReadSectionSettings(HobovrDriverSettings_t& out) {
+	out.fMaxLinVel = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_MaxLinearVelocity_Float);
+	out.fMaxAngVel = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_MaxAngularVelocity_Float);
+
+	DriverLog("driver: pose validation: max linear velocity %fm/s, max angular velocity %frad/s", out.fMaxLinVel, out.fMaxAngVel);
+
+	// world from source calibration, per udu index with a shared default
+	char buff[256] = "";
+	hobovr::HobovrCalibration_t defaultCal = hobovr::k_IdentityCalibration;
+	vr::VRSettings()->GetString(hobovr::k_pch_Calibration_Section, hobovr::k_pch_Calibration_Default_String, buff, sizeof(buff));
+	if (buff[0] && !hobovr::ParseCalibration(buff, defaultCal))
+		DriverLog("driver: default calibration '%s' is invalid, using none\n", buff);
+
+	for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++) {
+		char key[32];
+		snprintf(key, sizeof(key), hobovr::k_pch_Calibration_DeviceKeyFormat, i);
+
+		vr::EVRSettingsError err = vr::VRSettingsError_None;
+		buff[0] = 0;
+		vr::VRSettings()->GetString(hobovr::k_pch_Calibration_Section, key, buff, sizeof(buff), &err);
+
+		hobovr::HobovrCalibration_t cal = defaultCal;
+		if (err == vr::VRSettingsError_None && buff[0] && !hobovr::ParseCalibration(buff, cal)) {
+			DriverLog("driver: device %u calibration '%s' is invalid, using the default\n", i, buff);
+			cal = defaultCal;
+		}
+
+		out.vCalibration[i] = cal;
+		if (!hobovr::IsIdentityCalibration(cal) && i < m_vDevices.size())
+			DriverLog("driver: device %u calibration: %s", i, hobovr::FormatCalibration(cal).c_str());
+	}
+
+	// outlier gating, velocity estimation, filtering and prediction, the display horizon comes from the hmd, the rest is per device class
+	out.fVsyncToPhotons = vr::VRSettings()->GetFloat(k_pch_Hmd_Section, k_pch_Hmd_SecondsFromVsyncToPhotons_Float);
+	out.fDisplayFrequency = vr::VRSettings()->GetFloat(k_pch_Hmd_Section, k_pch_Hmd_DisplayFrequency_Float);
+
+	const char* const sections[3] = {k_pch_Hmd_Section, hobovr::k_pch_Controller_Section, k_pch_Tracker_Section};
+	for (int i = 0; i < 3; i++) {
+		vr::VRSettings()->GetString(sections[i], hobovr::k_pch_Pipeline_Stages_String, buff, sizeof(buff));
+		if (!hobovr::ParsePoseStages(buff, out.vPipeline[i])) {
+			DriverLog("driver: %s pose stages '%s' are invalid, using the default ones\n", sections[i], buff);
+			hobovr::ParsePoseStages(hobovr::k_pch_Pipeline_DefaultStages, out.vPipeline[i]);
+		}
+
+		DriverLog("driver: %s pose stages: validate calibrate %s", sections[i], hobovr::FormatPoseStages(out.vPipeline[i]).c_str());
+
+		out.vOutlierParams[i].bEnable = vr::VRSettings()->GetBool(sections[i], hobovr::k_pch_Outlier_Enable_Bool);
+		out.vOutlierParams[i].fPosTolerance = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Outlier_PositionTolerance_Float);
+		out.vOutlierParams[i].fMaxAcceleration = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Outlier_MaxAcceleration_Float);
+		out.vOutlierParams[i].iAcceptCount = vr::VRSettings()->GetInt32(sections[i], hobovr::k_pch_Outlier_AcceptCount_Int32);
+
+		DriverLog("driver: %s outlier gate: enabled %d, tolerance %fm, max acceleration %fm/s^2, accept after %d",
+			sections[i],
+			(int)out.vOutlierParams[i].bEnable,
+			out.vOutlierParams[i].fPosTolerance,
+			out.vOutlierParams[i].fMaxAcceleration,
+			out.vOutlierParams[i].iAcceptCount
+		);
+
+		out.vbVelocityEstimate[i] = vr::VRSettings()->GetBool(sections[i], hobovr::k_pch_VelocityEstimate_Enable_Bool);
+		DriverLog("driver: %s velocity estimation: enabled %d", sections[i], (int)out.vbVelocityEstimate[i]);
+
+		out.vPredictionParams[i].bEnable = vr::VRSettings()->GetBool(sections[i], hobovr::k_pch_Prediction_Enable_Bool);
+		out.vPredictionParams[i].fMaxSeconds = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Prediction_MaxSeconds_Float);
+		out.vPredictionParams[i].fMaxAcceleration = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Prediction_MaxAcceleration_Float);
+
+		DriverLog("driver: %s prediction: enabled %d, max %fs, max acceleration %fm/s^2",
+			sections[i],
+			(int)out.vPredictionParams[i].bEnable,
+			out.vPredictionParams[i].fMaxSeconds,
+			out.vPredictionParams[i].fMaxAcceleration
+		);
+
+		out.vFilterParams[i].bEnable = vr::VRSettings()->GetBool(sections[i], hobovr::k_pch_Filter_Enable_Bool);
+		out.vFilterParams[i].fPosMinCutoff = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Filter_PositionMinCutoff_Float);
+		out.vFilterParams[i].fPosBeta = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Filter_PositionBeta_Float);
+		out.vFilterParams[i].fRotMinCutoff = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Filter_RotationMinCutoff_Float);
+		out.vFilterParams[i].fRotBeta = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Filter_RotationBeta_Float);
+
+		DriverLog("driver: %s jitter filter: enabled %d, position %fHz beta %f, rotation %fHz beta %f",
+			sections[i],
+			(int)out.vFilterParams[i].bEnable,
+			out.vFilterParams[i].fPosMinCutoff,
+			out.vFilterParams[i].fPosBeta,
+			out.vFilterParams[i].fRotMinCutoff,
+			out.vFilterParams[i].fRotBeta
+		);
+
+		out.vWatchdogParams[i].bEnable = vr::VRSettings()->GetBool(sections[i], hobovr::k_pch_Watchdog_Enable_Bool);
+		out.vWatchdogParams[i].fStaleSeconds = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Watchdog_StaleSeconds_Float);
+		out.vWatchdogParams[i].fBridgeSeconds = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Watchdog_BridgeSeconds_Float);
+		out.vWatchdogParams[i].fDecaySeconds = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_Watchdog_VelocityDecay_Float);
+
+		DriverLog("driver: %s watchdog: enabled %d, stale after %fs, bridged for %fs, velocity decay %fs",
+			sections[i],
+			(int)out.vWatchdogParams[i].bEnable,
+			out.vWatchdogParams[i].fStaleSeconds,
+			out.vWatchdogParams[i].fBridgeSeconds,
+			out.vWatchdogParams[i].fDecaySeconds
+		);
+	}
+
+	// submission rate caps, per device class with per serial overrides
+	for (int i = 0; i < 3; i++) {
+		out.vfMaxSubmitRate[i] = vr::VRSettings()->GetFloat(sections[i], hobovr::k_pch_RateLimit_MaxSubmitRate_Float);
+		DriverLog("driver: %s submit rate limit: %fHz", sections[i], out.vfMaxSubmitRate[i]);
+	}
+
+	for (auto& i : m_vDevices)
+		ReadSubmitRateOverride(i, out.vSubmitRateOverrides);
+
+	for (auto& i : m_vStandbyDevices)
+		ReadSubmitRateOverride(i, out.vSubmitRateOverrides);
+
+	// parallel pose stages, the worker count only changes on restart
+	out.unParallelMinDevices = (uint32_t)std::max(vr::VRSettings()->GetInt32(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_PipelineParallelMinDevices_Int32), 1);
+	out.bPoseStageTimers = vr::VRSettings()->GetBool(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_PoseStageTimers_Bool);
+	DriverLog("driver: pose pipeline: parallel from %u devices, stage timers %d", out.unParallelMinDevices, (int)out.bPoseStageTimers);
+
+	// neck model, hmds streaming only rotation
+	out.neckModelParams.bEnable = vr::VRSettings()->GetBool(k_pch_Hmd_Section, hobovr::k_pch_Hmd_NeckModelEnable_Bool);
+	out.neckModelParams.fHeight = vr::VRSettings()->GetFloat(k_pch_Hmd_Section, hobovr::k_pch_Hmd_NeckModelHeight_Float);
+	out.neckModelParams.fEyeDepth = vr::VRSettings()->GetFloat(k_pch_Hmd_Section, k_pch_Hmd_UserHead2EyeDepthMeters_Float);
+
+	DriverLog("driver: neck model: enabled %d, height %fm, eye depth %fm", (int)out.neckModelParams.bEnable, out.neckModelParams.fHeight, out.neckModelParams.fEyeDepth);
+
+	// imu fusion, driver wide
+	out.imuNoise.fGyro = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_ImuGyroNoise_Float);
+	out.imuNoise.fAccel = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_ImuAccelNoise_Float);
+	out.imuNoise.fGyroBiasWalk = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_ImuGyroBiasWalk_Float);
+	out.imuNoise.fAccelBiasWalk = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_ImuAccelBiasWalk_Float);
+	out.imuNoise.fOptical = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_ImuOpticalNoise_Float);
+
+	DriverLog("driver: imu fusion: gyro noise %f, accel noise %f, gyro bias walk %f, accel bias walk %f, optical noise %fm",
+		out.imuNoise.fGyro,
+		out.imuNoise.fAccel,
+		out.imuNoise.fGyroBiasWalk,
+		out.imuNoise.fAccelBiasWalk,
+		out.imuNoise.fOptical
+	);
+
+	// upsampling, driver wide
+	out.bUpsample = vr::VRSettings()->GetBool(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_UpsampleEnable_Bool);
+	float fUpsampleRate = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_UpsampleRate_Float);
+	out.fUpsampleRate = std::min(std::max(fUpsampleRate > 0.f ? fUpsampleRate : out.fDisplayFrequency, 10.f), 1000.f);
+	out.fUpsampleLatency = std::max(vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_UpsampleLatency_Float), 0.f);
+	out.fUpsampleMaxExtrapolation = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_UpsampleMaxExtrapolation_Float);
+
+	DriverLog("driver: upsampling: enabled %d, rate %fHz, latency %fs", (int)out.bUpsample, out.fUpsampleRate, out.fUpsampleLatency);
+
+	// vsync aligned submission, driver wide
+	out.bVsyncSubmit = vr::VRSettings()->GetBool(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_VsyncSubmitEnable_Bool);
+	out.fVsyncMargin = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, hobovr::k_pch_Hobovr_VsyncSubmitMargin_Float);
+
+	DriverLog("driver: vsync aligned submission: enabled %d, display %fHz, margin %fs", (int)out.bVsyncSubmit, out.fDisplayFrequency, out.fVsyncMargin);
+}
+
+// hands read settings to the stages, on init before any thread runs and from ApplyPendingSettings() after that
+void CServerDriver_hobovr::ApplySectionSettings(const HobovrDriverSettings_t& settings) {
+	m_PoseValidator.SetLimits(settings.fMaxLinVel, settings.fMaxAngVel);
+	m_OutlierGate.SetLimits(settings.fMaxLinVel, settings.fMaxAngVel);
+
+	for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++)
+		m_Calibration.SetSlot(i, settings.vCalibration[i]);
+
+	m_PosePredictor.SetDisplayTiming(settings.fVsyncToPhotons, settings.fDisplayFrequency);
+
+	for (int i = 0; i < 3; i++) {
+		m_PosePipeline.SetClassStages(i, settings.vPipeline[i]);
+		m_vOutlierParams[i] = settings.vOutlierParams[i];
+		m_vbVelocityEstimate[i] = settings.vbVelocityEstimate[i];
+		m_vPredictionParams[i] = settings.vPredictionParams[i];
+		m_vFilterParams[i] = settings.vFilterParams[i];
+		m_vWatchdogParams[i] = settings.vWatchdogParams[i];
+		m_vfMaxSubmitRate[i] = settings.vfMaxSubmitRate[i];
+	}
+
+	m_vSubmitRateOverrides = settings.vSubmitRateOverrides;
+
+	m_bWatchdog = m_vWatchdogParams[0].bEnable || m_vWatchdogParams[1].bEnable || m_vWatchdogParams[2].bEnable;
+	m_unParallelMinDevices = settings.unParallelMinDevices;
+	m_PosePipeline.SetTimers(settings.bPoseStageTimers);
+	m_NeckModelParams = settings.neckModelParams;
+	m_ImuFusion.SetNoise(settings.imuNoise);
+
+	m_fUpsampleRate = settings.fUpsampleRate;
+	m_fUpsampleLatency = settings.fUpsampleLatency;
+	m_PoseUpsampler.SetMaxExtrapolation(settings.fUpsampleMaxExtrapolation);
+
+	if (settings.bUpsample != m_bUpsample) {
+		for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++)
+			m_PoseUpsampler.ResetSlot(i); // history stopped being recorded while it was off
+
+		m_bUpsample = settings.bUpsample;
+	}
+
+	m_VsyncScheduler.SetDisplayTiming(settings.fDisplayFrequency, settings.fVsyncMargin);
+
+	if (settings.bVsyncSubmit != m_bVsyncSubmit) {
+		for (uint32_t i = 0; i < hobovr::k_unMaxHotStateDevices; i++)
+			m_VsyncScheduler.ResetSlot(i);
+
+		m_bVsyncSubmit = settings.bVsyncSubmit;
+	}
+
+	SetDevicesPosePaced(m_bUpsample || m_bVsyncSubmit);
+
+	for (uint32_t i = 0; i < m_HotState.count && i < m_vDevices.size(); i++) {
+		m_OutlierGate.SetSlotParams(i, m_vOutlierParams[(int)m_vDevices[i].type]);
+		m_VelocityEstimator.SetSlotEnabled(i, m_vbVelocityEstimate[(int)m_vDevices[i].type]);
+		m_JitterFilter.SetSlotParams(i, m_vFilterParams[(int)m_vDevices[i].type]);
+		m_PosePredictor.SetSlotParams(i, m_vPredictionParams[(int)m_vDevices[i].type]);
+		m_Watchdog.SetSlotParams(i, m_vWatchdogParams[(int)m_vDevices[i].type]);
+		m_NeckModel.SetSlotParams(i, m_vDevices[i].type == EHobovrDeviceNodeTypes::hmd ? m_NeckModelParams : hobovr::HobovrNeckModelParams_t{});
+	}
+
+	ApplySubmitRateLimits();
+}
+
+// submits upsampled poses at m_fUpsampleRate, m_fUpsampleLatency behind real time,
+// dead reckoned or out of range poses for stalled devices and poses held back by the rate limits
+// with vsync aligned submission the ticks follow the compositor's pose reads instead of m_fUpsampleRate
+void CServerDriver_hobovr::PacedThread() {
+	DriverLog("driver: paced thread started\n");
+	auto next = std::chrono::steady_clock::now();
+
+	while (m_bPacedThreadIsAlive) {
+		auto now = std::chrono::steady_clock::now();
+		bool bIdle;
+
+		{
+			// settings are applied under the same lock
+			std::lock_guard<std::mutex> lock(m_DeviceListMutex);
+			bIdle = !m_bUpsample && !m_bWatchdog && !m_bRateLimit && !m_bVsyncSubmit;
+
+			if (!bIdle && m_bVsyncSubmit) {
+				double tNow = hobovr::ToSteadySeconds(now);
+				if (tNow - m_fVsyncTimingPollTime > k_fVsyncTimingPollSeconds) {
+					UpdateVsyncTiming();
+					m_fVsyncTimingPollTime = tNow;
 				}
-				return false;
-			};
-
-			auto res = std::find_if(m_vStandbyDevices.begin(), m_vStandbyDevices.end(), key);
-			if (res != m_vStandbyDevices.end()) {
-				((HeadsetDriver*)((*res).handle))->PowerOn();
-				m_vDevices.push_back(*res);
-				m_vStandbyDevices.erase(res);
-			} else {
-				HeadsetDriver* temp = new HeadsetDriver(
-					"h" + std::to_string(counter_hmd)
-				);
 
-				vr::VRServerDriverHost()->TrackedDeviceAdded(
-					temp->GetSerialNumber().c_str(),
-					vr::TrackedDeviceClass_HMD,
-					temp
-				);
-				m_vDevices.push_back({EHobovrDeviceNodeTypes::hmd, temp});
+				// steady seconds count from the clock's epoch, so they map straight back to a time point
+				next = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(m_VsyncScheduler.NextSubmitTime(tNow))
+				));
+
+			} else if (!bIdle) {
+				next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_fUpsampleRate));
+
+				// fell behind, skip the missed ticks instead of bursting through them
+				if (next < now)
+					next = now;
 			}
+		}
 
-			counter_hmd++;
-		} else if (i.first == "c") {
-			auto target = "c" + std::to_string(counter_cntrlr);
-			auto key = [target](HobovrDeviceStorageNode_t d)->bool {
-				switch (d.type) {
-					case EHobovrDeviceNodeTypes::hmd:
-						return ((HeadsetDriver*)d.handle)->GetSerialNumber() == target;
-
-					case EHobovrDeviceNodeTypes::controller:
-						return ((ControllerDriver*)d.handle)->GetSerialNumber() == target;
-
-					case EHobovrDeviceNodeTypes::tracker:
-						return ((TrackerDriver*)d.handle)->GetSerialNumber() == target;
-				}
-				return false;
-			};
-
-			auto res = std::find_if(m_vStandbyDevices.begin(), m_vStandbyDevices.end(), key);
-			if (res != m_vStandbyDevices.end()) {
-				((ControllerDriver*)((*res).handle))->PowerOn();
-				m_vDevices.push_back(*res);
-				m_vStandbyDevices.erase(res);
-			} else {
-				ControllerDriver* temp = new ControllerDriver(
-					controller_hs,
-					"c" + std::to_string(counter_cntrlr),
-					m_pSocketComm
-				);
+		if (bIdle) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			next = std::chrono::steady_clock::now();
+			continue;
+		}
 
-				vr::VRServerDriverHost()->TrackedDeviceAdded(
-					temp->GetSerialNumber().c_str(),
-					vr::TrackedDeviceClass_Controller,
-					temp
-				);
-				m_vDevices.push_back({EHobovrDeviceNodeTypes::controller, temp});
+		std::this_thread::sleep_until(next);
+
+		std::lock_guard<std::mutex> lock(m_DeviceListMutex);
+
+		double tNow = hobovr::GetSteadySeconds();
+		double t = tNow - (double)m_fUpsampleLatency;
+
+		for (uint32_t i = 0; i < m_HotState.count; i++) {
+			hobovr::EHobovrWatchdogAction action = m_Watchdog.Evaluate(i, tNow, m_PacedState);
 
+			if (action == hobovr::EWatchdog_Bridge || action == hobovr::EWatchdog_Lost) {
+				bool bLost = action == hobovr::EWatchdog_Lost;
+				vr::ETrackingResult result = bLost ? vr::TrackingResult_Running_OutOfRange : vr::TrackingResult_Running_OK;
+
+				VisitDevice(m_vDevices[i], [&](auto* device) {
+					device->SubmitWatchdogPose(m_PacedState, result, !bLost);
+				});
 			}
 
-			controller_hs = (controller_hs) ? 0 : 1;
-			counter_cntrlr++;
+			if (action != hobovr::EWatchdog_None) {
+				if (action == hobovr::EWatchdog_Lost)
+					m_HotState.stats[i].streamLost++;
+				else if (action == hobovr::EWatchdog_Bridge && !m_vbWatchdogBridging[i])
+					m_HotState.stats[i].streamStalls++;
 
-		} else if (i.first == "t") {
-			auto target = "t" + std::to_string(counter_trkr);
-			auto key = [target](HobovrDeviceStorageNode_t d)->bool {
-				switch (d.type) {
-					case EHobovrDeviceNodeTypes::hmd:
-						return ((HeadsetDriver*)d.handle)->GetSerialNumber() == target;
+				m_vbWatchdogBridging[i] = true;
+				continue; // stalled devices aren't upsampled
+			}
 
-					case EHobovrDeviceNodeTypes::controller:
-						return ((ControllerDriver*)d.handle)->GetSerialNumber() == target;
+			m_vbWatchdogBridging[i] = false;
 
-					case EHobovrDeviceNodeTypes::tracker:
-						return ((TrackerDriver*)d.handle)->GetSerialNumber() == target;
-				}
-				return false;
-			};
-
-			auto res = std::find_if(m_vStandbyDevices.begin(), m_vStandbyDevices.end(), key);
-			if (res != m_vStandbyDevices.end()) {
-				((TrackerDriver*)((*res).handle))->PowerOn();
-				m_vDevices.push_back(*res);
-				m_vStandbyDevices.erase(res);
-			} else {
-				TrackerDriver* temp = new TrackerDriver("t" + std::to_string(counter_trkr), m_pSocketComm);
-
-				vr::VRServerDriverHost()->TrackedDeviceAdded(
-					temp->GetSerialNumber().c_str(),
-					vr::TrackedDeviceClass_GenericTracker,
-					temp
-				);
-				m_vDevices.push_back({EHobovrDeviceNodeTypes::tracker, temp});
+			if (m_bVsyncSubmit && !m_bUpsample) {
+				// the freshest pipeline output since the last read
+				if (!m_VsyncScheduler.Take(i, m_PacedState) || !m_RateLimiter.Consume(i, tNow))
+					continue;
 
+				VisitDevice(m_vDevices[i], [&](auto* device) {
+					device->SubmitPacedPose(m_PacedState);
+				});
+				continue;
 			}
 
-			counter_trkr++;
+			if (!m_bUpsample) {
+				// the latest pose the rate limit held back, once the device's interval is up
+				if (!m_RateLimiter.TakePending(i, tNow, m_PacedState))
+					continue;
+
+				VisitDevice(m_vDevices[i], [&](auto* device) {
+					device->SubmitDeferredPose(m_PacedState);
+				});
+				continue;
+			}
+
+			if (!m_PoseUpsampler.Evaluate(i, t, m_PacedState) || !m_RateLimiter.Consume(i, tNow))
+				continue;
+
+			VisitDevice(m_vDevices[i], [&](auto* device) {
+				device->SubmitPacedPose(m_PacedState);
+			});
 		}
 	}
 
-	g_vpUduChangeBuffer.clear();
+	DriverLog("driver: paced thread stopped\n");
+}
+
+// phase of the compositor's pose reads, from its latest frame timing
+// without a running compositor the vsync timeline from the settings is used as is
+void CServerDriver_hobovr::UpdateVsyncTiming() {
+	vr::Compositor_FrameTiming timing = {};
+	timing.m_nSize = sizeof(timing);
+
+	hobovr::EHobovrVsyncSource lastSource = m_VsyncScheduler.GetSource();
+
+	if (vr::VRServerDriverHost()->GetFrameTimings(&timing, 1) && timing.m_nFrameIndex != 0)
+		m_VsyncScheduler.SetCompositorTiming(timing.m_flSystemTimeInSeconds, (double)timing.m_flNewPosesReadyMs * 1e-3);
+	else
+		m_VsyncScheduler.SetSettingsTiming();
+
+	if (m_VsyncScheduler.GetSource() != lastSource)
+		DriverLog("driver: vsync aligned submission: timing from %s", m_VsyncScheduler.GetSource() == hobovr::EVsyncSource_Compositor ? "the compositor" : "the settings");
 }
 
 void CServerDriver_hobovr::SlowUpdateThread() {
 	DriverLog("driver: slow update thread started\n");
 	int h = 0;
 	while (m_bSlowUpdateThreadIsAlive){
+		std::unique_lock<std::mutex> lock(m_DeviceListMutex);
 		for (auto &i : m_vDevices){
-			switch (i.type) {
-				case EHobovrDeviceNodeTypes::hmd: {
-					HeadsetDriver* device = (HeadsetDriver*)i.handle;
-					device->UpdateDeviceBatteryCharge();
-					device->CheckForUpdates();
-					break;
-				}
-
-				case EHobovrDeviceNodeTypes::controller: {
-					ControllerDriver* device = (ControllerDriver*)i.handle;
-					device->UpdateDeviceBatteryCharge();
-					device->CheckForUpdates();
-					break;
-				}
+			VisitDevice(i, [&](auto* device) {
+				device->UpdateDeviceBatteryCharge();
+				device->CheckForUpdates();
+			});
+		}
 
-				case EHobovrDeviceNodeTypes::tracker: {
-					TrackerDriver* device = (TrackerDriver*)i.handle;
-					device->UpdateDeviceBatteryCharge();
-					device->CheckForUpdates();
-					break;
-				}
+		// log devices whose counters moved since the last time
+		for (uint32_t i = 0; i < m_HotState.count; i++) {
+			if (!hobovr::HotStateStatsEqual(m_HotState.stats[i], m_vLastLoggedStats[i])) {
+				char buff[256];
+				hobovr::HotStateFormatStats(m_HotState, i, buff, sizeof(buff));
+				DriverLog("driver: device %d stats: %s", (int)i, buff);
+				m_vLastLoggedStats[i] = m_HotState.stats[i];
 			}
 		}
+		lock.unlock();
 
 		std::this_thread::sleep_for(std::chrono::seconds(5));
 
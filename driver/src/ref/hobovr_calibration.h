@@ -0,0 +1,338 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_CALIBRATION_H
+#define HOBOVR_CALIBRATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// calibrations live in their own section, one key per udu index plus a default for devices without one
+	static const char *const k_pch_Calibration_Section = "hobovr_calibration";
+	static const char *const k_pch_Calibration_Default_String = "Default";
+	static const char *const k_pch_Calibration_DeviceKeyFormat = "Device%u"; // udu index
+
+	// world from source transform of a pose source
+	// world = translation + scale * rotation * remap(source), the remap is applied first and also
+	// converts the source's device axes, so it can flip handedness, the rest is a plain similarity transform
+	struct HobovrCalibration_t {
+		float rot[4]; // wxyz
+		float trans[3]; // m
+		float scale;
+		int axes[3]; // world axis j is source axis |axes[j]| - 1, negated if axes[j] < 0
+	};
+
+	static const HobovrCalibration_t k_IdentityCalibration = {{1.f, 0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}, 1.f, {1, 2, 3}};
+
+	inline bool IsIdentityCalibration(const HobovrCalibration_t& c) {
+		return c.rot[0] == 1.f && c.rot[1] == 0.f && c.rot[2] == 0.f && c.rot[3] == 0.f &&
+			c.trans[0] == 0.f && c.trans[1] == 0.f && c.trans[2] == 0.f && c.scale == 1.f &&
+			c.axes[0] == 1 && c.axes[1] == 2 && c.axes[2] == 3;
+	}
+
+	// checks the remap is a signed permutation, the scale positive and normalizes the rotation
+	inline bool ValidateCalibration(HobovrCalibration_t& c) {
+		int seen = 0;
+		for (int j = 0; j < 3; j++) {
+			int a = std::abs(c.axes[j]);
+			if (a < 1 || a > 3 || (seen & (1 << a)))
+				return false;
+			seen |= 1 << a;
+		}
+
+		float n2 = c.rot[0]*c.rot[0] + c.rot[1]*c.rot[1] + c.rot[2]*c.rot[2] + c.rot[3]*c.rot[3];
+		if (!std::isfinite(n2) || n2 < 1e-6f || !std::isfinite(c.scale) || c.scale <= 0.f)
+			return false;
+
+		if (!std::isfinite(c.trans[0]) || !std::isfinite(c.trans[1]) || !std::isfinite(c.trans[2]))
+			return false;
+
+		float invLen = 1.f / std::sqrt(n2);
+		for (int j = 0; j < 4; j++)
+			c.rot[j] *= invLen;
+
+		return true;
+	}
+
+	// "qw qx qy qz tx ty tz scale axes", axes is one signed axis letter per world axis, "+x+y+z" is no remap
+	// e.g. "1 0 0 0 0 0 0 1 +x+z-y" takes a z up source to steamvr's y up
+	inline bool ParseCalibration(const std::string& text, HobovrCalibration_t& out) {
+		std::istringstream ss(text);
+		HobovrCalibration_t c;
+		std::string axes;
+
+		if (!(ss >> c.rot[0] >> c.rot[1] >> c.rot[2] >> c.rot[3] >> c.trans[0] >> c.trans[1] >> c.trans[2] >> c.scale >> axes))
+			return false;
+
+		size_t k = 0;
+		for (int j = 0; j < 3; j++) {
+			int sign = 1;
+			if (k < axes.size() && (axes[k] == '+' || axes[k] == '-'))
+				sign = axes[k++] == '-' ? -1 : 1;
+
+			if (k >= axes.size() || axes[k] < 'x' || axes[k] > 'z')
+				return false;
+
+			c.axes[j] = sign * (axes[k++] - 'x' + 1);
+		}
+
+		if (k != axes.size() || !ValidateCalibration(c))
+			return false;
+
+		out = c;
+		return true;
+	}
+
+	inline std::string FormatCalibration(const HobovrCalibration_t& c) {
+		char buff[256];
+		snprintf(buff, sizeof(buff), "%.7g %.7g %.7g %.7g %.7g %.7g %.7g %.7g %c%c%c%c%c%c",
+			c.rot[0], c.rot[1], c.rot[2], c.rot[3], c.trans[0], c.trans[1], c.trans[2], c.scale,
+			c.axes[0] < 0 ? '-' : '+', 'x' + std::abs(c.axes[0]) - 1,
+			c.axes[1] < 0 ? '-' : '+', 'x' + std::abs(c.axes[1]) - 1,
+			c.axes[2] < 0 ? '-' : '+', 'x' + std::abs(c.axes[2]) - 1
+		);
+		return buff;
+	}
+
+	// applies every slot's calibration to its pose in one pass, right after validation so every later stage works in world space
+	// with M the remap and M' = det(M)*M its proper rotation part:
+	//   pos' = t + s*R*M*pos, vel' = s*R*M*vel, angVel' = R*M'*angVel (a pseudo vector, mirrors don't flip it)
+	//   rot' = R*M'*rot*M'^-1, mirroring a rotation is the same as conjugating it with M'
+	// everything is folded into per slot matrices and quaternions when a calibration is set,
+	// the pass itself is two matrix products and two quaternion products, 4 slots at a time with sse2
+	class HobovrCalibrationStage {
+	public:
+		HobovrCalibrationStage() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				SetSlot(i, k_IdentityCalibration);
+		}
+
+		// c has to be valid, see ValidateCalibration()
+		void SetSlot(uint32_t i, const HobovrCalibration_t& c) {
+			m_vbSet[i] = !IsIdentityCalibration(c);
+			m_bAnySet = false;
+			for (uint32_t j = 0; j < k_unMaxHotStateDevices; j++)
+				m_bAnySet |= m_vbSet[j];
+
+			// remap as a matrix, and its determinant
+			float m[9] = {};
+			for (int j = 0; j < 3; j++)
+				m[j*3 + std::abs(c.axes[j]) - 1] = c.axes[j] < 0 ? -1.f : 1.f;
+
+			float det = m[0]*(m[4]*m[8] - m[5]*m[7]) - m[1]*(m[3]*m[8] - m[5]*m[6]) + m[2]*(m[3]*m[7] - m[4]*m[6]);
+			float mp[9];
+			for (int j = 0; j < 9; j++)
+				mp[j] = det*m[j];
+
+			float r[9];
+			QuatToMatrix(c.rot, r);
+
+			float rm[9], rmp[9];
+			MatMul(r, m, rm);
+			MatMul(r, mp, rmp);
+
+			for (int j = 0; j < 9; j++) {
+				m_vLin[j][i] = c.scale*rm[j];
+				m_vAng[j][i] = rmp[j];
+			}
+
+			for (int j = 0; j < 3; j++)
+				m_vTrans[j][i] = c.trans[j];
+
+			// rot' = (R*M') * rot * M'^-1
+			float qm[4], qa[4];
+			MatrixToQuat(mp, qm);
+			QuatMul(c.rot, qm, qa);
+
+			for (int j = 0; j < 4; j++) {
+				m_vQuatL[j][i] = qa[j];
+				m_vQuatR[j][i] = j ? -qm[j] : qm[j];
+			}
+		}
+
+		bool IsSlotSet(uint32_t i) const {
+			return m_vbSet[i];
+		}
+
+		// transforms updated slots in [begin, end), begin has to be a multiple of 4
+		// the range gets rounded up to a multiple of 4, unused slots are never updated so that is fine
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			if (!m_bAnySet)
+				return;
+
+			end = std::min((end + 3u) & ~3u, k_unMaxHotStateDevices);
+
+#ifdef HOBOVR_USE_SSE2
+			for (uint32_t i = begin; i < end; i += 4)
+				RunGroup(s, i);
+#else
+			for (uint32_t i = begin; i < end; i++) {
+				if ((s.flags[i] & EHotState_Updated) && m_vbSet[i])
+					RunSlot(s, i);
+			}
+#endif
+		}
+
+	private:
+		static void QuatToMatrix(const float* q, float* r) {
+			float w = q[0], x = q[1], y = q[2], z = q[3];
+			r[0] = 1 - 2*(y*y + z*z); r[1] = 2*(x*y - w*z);     r[2] = 2*(x*z + w*y);
+			r[3] = 2*(x*y + w*z);     r[4] = 1 - 2*(x*x + z*z); r[5] = 2*(y*z - w*x);
+			r[6] = 2*(x*z - w*y);     r[7] = 2*(y*z + w*x);     r[8] = 1 - 2*(x*x + y*y);
+		}
+
+		// r has to be a proper rotation, only ever called on signed permutations
+		static void MatrixToQuat(const float* r, float* q) {
+			float tr = r[0] + r[4] + r[8];
+			if (tr > 0.f) {
+				float k = 2.f*std::sqrt(tr + 1.f);
+				q[0] = 0.25f*k; q[1] = (r[7] - r[5]) / k; q[2] = (r[2] - r[6]) / k; q[3] = (r[3] - r[1]) / k;
+			} else if (r[0] > r[4] && r[0] > r[8]) {
+				float k = 2.f*std::sqrt(1.f + r[0] - r[4] - r[8]);
+				q[0] = (r[7] - r[5]) / k; q[1] = 0.25f*k; q[2] = (r[1] + r[3]) / k; q[3] = (r[2] + r[6]) / k;
+			} else if (r[4] > r[8]) {
+				float k = 2.f*std::sqrt(1.f + r[4] - r[0] - r[8]);
+				q[0] = (r[2] - r[6]) / k; q[1] = (r[1] + r[3]) / k; q[2] = 0.25f*k; q[3] = (r[5] + r[7]) / k;
+			} else {
+				float k = 2.f*std::sqrt(1.f + r[8] - r[0] - r[4]);
+				q[0] = (r[3] - r[1]) / k; q[1] = (r[2] + r[6]) / k; q[2] = (r[5] + r[7]) / k; q[3] = 0.25f*k;
+			}
+		}
+
+		static void MatMul(const float* a, const float* b, float* r) {
+			for (int row = 0; row < 3; row++)
+				for (int col = 0; col < 3; col++)
+					r[row*3 + col] = a[row*3]*b[col] + a[row*3 + 1]*b[3 + col] + a[row*3 + 2]*b[6 + col];
+		}
+
+		static void QuatMul(const float* a, const float* b, float* r) {
+			r[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+			r[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+			r[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+			r[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+		}
+
+#ifdef HOBOVR_USE_SSE2
+		static inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		// (x, y, z) = m * (x, y, z) for 4 slots, m is a per slot 3x3 matrix, rows first
+		static inline void MulVec3(const float (*m)[k_unMaxHotStateDevices], uint32_t i, __m128& x, __m128& y, __m128& z) {
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(m[0] + i), x), _mm_mul_ps(_mm_load_ps(m[1] + i), y)), _mm_mul_ps(_mm_load_ps(m[2] + i), z));
+			__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(m[3] + i), x), _mm_mul_ps(_mm_load_ps(m[4] + i), y)), _mm_mul_ps(_mm_load_ps(m[5] + i), z));
+			__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(m[6] + i), x), _mm_mul_ps(_mm_load_ps(m[7] + i), y)), _mm_mul_ps(_mm_load_ps(m[8] + i), z));
+			x = rx;
+			y = ry;
+			z = rz;
+		}
+
+		static inline void QuatMul4(__m128 aw, __m128 ax, __m128 ay, __m128 az, __m128& bw, __m128& bx, __m128& by, __m128& bz) {
+			__m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_add_ps(_mm_mul_ps(ay, by), _mm_mul_ps(az, bz)));
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)));
+			__m128 ry = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)), _mm_add_ps(_mm_mul_ps(ay, bw), _mm_mul_ps(az, bx)));
+			__m128 rz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx)), _mm_mul_ps(az, bw));
+			bw = rw;
+			bx = rx;
+			by = ry;
+			bz = rz;
+		}
+
+		void RunGroup(HobovrHotState_t& s, uint32_t i) {
+			__m128i updatedBit = _mm_set1_epi32((int)EHotState_Updated);
+			__m128 updated = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_load_si128((const __m128i*)(s.flags + i)), updatedBit), updatedBit));
+			if (!_mm_movemask_ps(updated))
+				return;
+
+			__m128 px = _mm_load_ps(s.posX + i), py = _mm_load_ps(s.posY + i), pz = _mm_load_ps(s.posZ + i);
+			__m128 vx = _mm_load_ps(s.velX + i), vy = _mm_load_ps(s.velY + i), vz = _mm_load_ps(s.velZ + i);
+			__m128 wx = _mm_load_ps(s.angVelX + i), wy = _mm_load_ps(s.angVelY + i), wz = _mm_load_ps(s.angVelZ + i);
+			__m128 qw = _mm_load_ps(s.rotW + i), qx = _mm_load_ps(s.rotX + i), qy = _mm_load_ps(s.rotY + i), qz = _mm_load_ps(s.rotZ + i);
+
+			__m128 npx = px, npy = py, npz = pz;
+			MulVec3(m_vLin, i, npx, npy, npz);
+			npx = _mm_add_ps(npx, _mm_load_ps(m_vTrans[0] + i));
+			npy = _mm_add_ps(npy, _mm_load_ps(m_vTrans[1] + i));
+			npz = _mm_add_ps(npz, _mm_load_ps(m_vTrans[2] + i));
+
+			__m128 nvx = vx, nvy = vy, nvz = vz;
+			MulVec3(m_vLin, i, nvx, nvy, nvz);
+
+			__m128 nwx = wx, nwy = wy, nwz = wz;
+			MulVec3(m_vAng, i, nwx, nwy, nwz);
+
+			// rot' = qa * rot * qb
+			__m128 nqw = _mm_load_ps(m_vQuatR[0] + i), nqx = _mm_load_ps(m_vQuatR[1] + i), nqy = _mm_load_ps(m_vQuatR[2] + i), nqz = _mm_load_ps(m_vQuatR[3] + i);
+			QuatMul4(qw, qx, qy, qz, nqw, nqx, nqy, nqz);
+			QuatMul4(_mm_load_ps(m_vQuatL[0] + i), _mm_load_ps(m_vQuatL[1] + i), _mm_load_ps(m_vQuatL[2] + i), _mm_load_ps(m_vQuatL[3] + i), nqw, nqx, nqy, nqz);
+
+			// slots that weren't updated already hold world space poses
+			_mm_store_ps(s.posX + i, Select(updated, npx, px));
+			_mm_store_ps(s.posY + i, Select(updated, npy, py));
+			_mm_store_ps(s.posZ + i, Select(updated, npz, pz));
+			_mm_store_ps(s.velX + i, Select(updated, nvx, vx));
+			_mm_store_ps(s.velY + i, Select(updated, nvy, vy));
+			_mm_store_ps(s.velZ + i, Select(updated, nvz, vz));
+			_mm_store_ps(s.angVelX + i, Select(updated, nwx, wx));
+			_mm_store_ps(s.angVelY + i, Select(updated, nwy, wy));
+			_mm_store_ps(s.angVelZ + i, Select(updated, nwz, wz));
+			_mm_store_ps(s.rotW + i, Select(updated, nqw, qw));
+			_mm_store_ps(s.rotX + i, Select(updated, nqx, qx));
+			_mm_store_ps(s.rotY + i, Select(updated, nqy, qy));
+			_mm_store_ps(s.rotZ + i, Select(updated, nqz, qz));
+		}
+#else
+		static inline void MulVec3(const float (*m)[k_unMaxHotStateDevices], uint32_t i, float& x, float& y, float& z) {
+			float rx = m[0][i]*x + m[1][i]*y + m[2][i]*z;
+			float ry = m[3][i]*x + m[4][i]*y + m[5][i]*z;
+			float rz = m[6][i]*x + m[7][i]*y + m[8][i]*z;
+			x = rx;
+			y = ry;
+			z = rz;
+		}
+
+		void RunSlot(HobovrHotState_t& s, uint32_t i) {
+			MulVec3(m_vLin, i, s.posX[i], s.posY[i], s.posZ[i]);
+			s.posX[i] += m_vTrans[0][i];
+			s.posY[i] += m_vTrans[1][i];
+			s.posZ[i] += m_vTrans[2][i];
+
+			MulVec3(m_vLin, i, s.velX[i], s.velY[i], s.velZ[i]);
+			MulVec3(m_vAng, i, s.angVelX[i], s.angVelY[i], s.angVelZ[i]);
+
+			float q[4] = {s.rotW[i], s.rotX[i], s.rotY[i], s.rotZ[i]};
+			float qa[4] = {m_vQuatL[0][i], m_vQuatL[1][i], m_vQuatL[2][i], m_vQuatL[3][i]};
+			float qb[4] = {m_vQuatR[0][i], m_vQuatR[1][i], m_vQuatR[2][i], m_vQuatR[3][i]};
+			float t[4], r[4];
+			QuatMul(q, qb, t);
+			QuatMul(qa, t, r);
+
+			s.rotW[i] = r[0];
+			s.rotX[i] = r[1];
+			s.rotY[i] = r[2];
+			s.rotZ[i] = r[3];
+		}
+#endif
+
+		bool m_vbSet[k_unMaxHotStateDevices];
+		bool m_bAnySet = false; // the whole pass is skipped when nothing is calibrated
+
+		// per slot transforms, rows first, identity for slots without a calibration
+		alignas(64) float m_vLin[9][k_unMaxHotStateDevices]; // s*R*M, positions and velocities
+		alignas(64) float m_vAng[9][k_unMaxHotStateDevices]; // R*M', angular velocities
+		alignas(64) float m_vTrans[3][k_unMaxHotStateDevices];
+		alignas(64) float m_vQuatL[4][k_unMaxHotStateDevices]; // R*M' as a quaternion, wxyz
+		alignas(64) float m_vQuatR[4][k_unMaxHotStateDevices]; // M'^-1
+	};
+}
+
+#endif // HOBOVR_CALIBRATION_H
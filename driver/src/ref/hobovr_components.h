@@ -39,7 +39,7 @@ namespace hobovr {
   static const bool HobovrExtDisplayComp_doLensStuff = true;
   static const short HobovrExtDisplayComp_lensDistortionType = ELensMathType::Mt_Default; // has to be one of hobovr::ELensMathType
 
-  class HobovrExtendedDisplayComponent: public vr::IVRDisplayComponent {
+  class HobovrExtendedDisplayComponent final: public vr::IVRDisplayComponent {
   public:
     HobovrExtendedDisplayComponent(){
 
@@ -240,21 +240,21 @@ namespace hobovr {
   };
 
   // this is a dummy class meant to expand the component handling system, DO NOT USE THIS!
-  class HobovrDriverDirectModeComponent {
+  class HobovrDriverDirectModeComponent final {
   public:
     HobovrDriverDirectModeComponent() {}
     virtual void ReloadSectionSettings() {} // this is here for compatibility reasons
   };
 
   // this is a dummy class meant to expand the component handling system, DO NOT USE THIS!
-  class HobovrCameraComponent {
+  class HobovrCameraComponent final {
   public:
     HobovrCameraComponent() {}
     virtual void ReloadSectionSettings() {} // this is here for compatibility reasons
   };
 
   // this is a dummy class meant to expand the component handling system, DO NOT USE THIS!
-  class HobovrVirtualDisplayComponent {
+  class HobovrVirtualDisplayComponent final {
   public:
     HobovrVirtualDisplayComponent() {}
     virtual void ReloadSectionSettings() {} // this is here for compatibility reasons
@@ -7,10 +7,18 @@
 #ifndef VR_DEVICE_BASE_H
 #define VR_DEVICE_BASE_H
 
+#include <mutex>
+
 #include "hobovr_components.h"
+#include "hobovr_math.h"
+#include "hobovr_hot_state.h"
 
 namespace hobovr {
 	static const char *const k_pch_Hobovr_PoseTimeOffset_Float = "PoseTimeOffset";
+	// subtracts the pose age from PoseTimeOffset for every pose, the age counts from when the bytes arrived
+	// off by default, dense and compact frames carry no sample age so their age would only count the driver side
+	// poses from sparse frames with a sample age, addressed frames with one and imu frames always get their real age subtracted
+	static const char *const k_pch_Hobovr_DynamicPoseTimeOffset_Bool = "DynamicPoseTimeOffset";
 	static const char *const k_pch_Hobovr_UpdateUrl_String = "ManualUpdateURL";
 
 	enum EHobovrCompType
@@ -22,6 +30,9 @@ namespace hobovr {
 		EHobovrComp_VirtualDisplay = 250, // HobovrVirtualDisplayComponent component, use only with vr::IVRVirtualDisplay_Version
 	};
 
+	// pose age is clamped to this, anything older is a stalled stream and not a latency
+	static const double k_fMaxPoseAgeSeconds = 0.1;
+
 	struct HobovrComponent_t
 	{
 		EHobovrCompType type;
@@ -76,6 +87,7 @@ namespace hobovr {
 			m_sModelNumber = deviceBreed + m_sSerialNumber;
 
 			m_fPoseTimeOffset = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, k_pch_Hobovr_PoseTimeOffset_Float);
+			m_bDynamicPoseTimeOffset = vr::VRSettings()->GetBool(k_pch_Hobovr_Section, k_pch_Hobovr_DynamicPoseTimeOffset_Bool);
 			char buff[1024];
 			vr::VRSettings()->GetString(k_pch_Hobovr_Section, k_pch_Hobovr_UpdateUrl_String, buff, sizeof(buff));
 			m_sUpdateUrl = buff;
@@ -85,27 +97,38 @@ namespace hobovr {
 			DriverLog("device: serial: %s\n", m_sSerialNumber.c_str());
 			DriverLog("device: model: %s\n", m_sModelNumber.c_str());
 			DriverLog("device: pose time offset: %f\n", m_fPoseTimeOffset);
+			DriverLog("device: dynamic pose time offset: %d\n", (int)m_bDynamicPoseTimeOffset);
 
 			if (m_pBrodcastSocket == nullptr && UseHaptics)
 				DriverLog("communication socket object is not supplied and haptics are enabled, this device will break on back communication requests(e.g. haptics)\n");
 
-			// m_Pose.result = TrackingResult_Running_OK;
-			// m_Pose.poseTimeOffset = (double)m_fPoseTimeOffset;
-			// m_Pose.qWorldFromDriverRotation = HmdQuaternion_Init(1, 0, 0, 0);
-			// m_Pose.qDriverFromHeadRotation = HmdQuaternion_Init(1, 0, 0, 0);
-			// m_Pose.qRotation = HmdQuaternion_Init(1, 0, 0, 0);
-			// m_Pose.vecPosition[0] = 0.;
-			// m_Pose.vecPosition[1] = 0.;
-			// m_Pose.vecPosition[2] = 0.;
-			// m_Pose.willDriftInYaw = true;
-			// m_Pose.deviceIsConnected = true;
-			// m_Pose.poseIsValid = true;
-			// m_Pose.shouldApplyHeadModel = false;
+			ResetPoseTemplate();
 		}
 
-		~HobovrDevice(){
-			for (auto &i : m_vComponents)
-				free(i.ptr_handle);
+		virtual ~HobovrDevice(){
+			// components are new'ed by the derived classes, they go as their own type
+			for (auto &i : m_vComponents) {
+				switch (i.type) {
+					case EHobovrCompType::EHobovrComp_ExtendedDisplay:
+						delete (HobovrExtendedDisplayComponent*)i.ptr_handle;
+						break;
+
+					case EHobovrCompType::EHobovrComp_DriverDirectMode:
+						delete (HobovrDriverDirectModeComponent*)i.ptr_handle;
+						break;
+
+					case EHobovrCompType::EHobovrComp_Camera:
+						delete (HobovrCameraComponent*)i.ptr_handle;
+						break;
+
+					case EHobovrCompType::EHobovrComp_VirtualDisplay:
+						delete (HobovrVirtualDisplayComponent*)i.ptr_handle;
+						break;
+
+					default:
+						break;
+				}
+			}
 
 			m_vComponents.clear();
 			DriverLog("device: with serial %s yeeted out of existence\n", m_sSerialNumber.c_str());
@@ -178,7 +201,7 @@ namespace hobovr {
 
 		virtual void PowerOff() {
 			// signal device is "aliven't"
-			vr::DriverPose_t pose;
+			vr::DriverPose_t pose = GetPose();
 			pose.poseTimeOffset = 0;
 			pose.poseIsValid = false;
 			pose.deviceIsConnected = false;
@@ -191,7 +214,7 @@ namespace hobovr {
 
 		virtual void PowerOn() {
 			// signal device is "alive"
-			vr::DriverPose_t pose;
+			vr::DriverPose_t pose = GetPose();
 			pose.poseTimeOffset = 0;
 			pose.poseIsValid = true;
 			pose.deviceIsConnected = true;
@@ -210,15 +233,21 @@ namespace hobovr {
 
 		virtual void EnterStandby() {}
 
-		/* debug request from a client, TODO: uh... actually implement this? */
+		/* debug request from a client, only "stats" is supported for now */
 		virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer,
 															uint32_t unResponseBufferSize) {
 			DriverLog("device: \"%s\" got a debug request: \"%s\"", m_sSerialNumber.c_str(), pchRequest);
 			if (unResponseBufferSize >= 1)
 				pchResponseBuffer[0] = 0;
+
+			if (!strcmp(pchRequest, "stats") && m_pHotState != nullptr && m_unHotStateIndex != k_unHotStateIndexInvalid)
+				HotStateFormatStats(*m_pHotState, m_unHotStateIndex, pchResponseBuffer, unResponseBufferSize);
 		}
 
-		virtual vr::DriverPose_t GetPose() {vr::DriverPose_t tmp; return tmp; }
+		virtual vr::DriverPose_t GetPose() {
+			std::lock_guard<std::mutex> lock(m_PoseMutex);
+			return m_Pose;
+		}
 
 		virtual void *GetComponent(const char *pchComponentNameAndVersion) {
 			for (auto &i : m_vComponents) {
@@ -287,6 +316,14 @@ namespace hobovr {
 						}
 					}
 					// handle device settings update
+					{
+						float fPoseTimeOffset = vr::VRSettings()->GetFloat(k_pch_Hobovr_Section, k_pch_Hobovr_PoseTimeOffset_Float);
+						bool bDynamicPoseTimeOffset = vr::VRSettings()->GetBool(k_pch_Hobovr_Section, k_pch_Hobovr_DynamicPoseTimeOffset_Bool);
+						std::lock_guard<std::mutex> lock(m_PoseMutex);
+						m_fPoseTimeOffset = fPoseTimeOffset;
+						m_bDynamicPoseTimeOffset = bDynamicPoseTimeOffset;
+					}
+					ResetPoseTemplate();
 					UpdateSectionSettings();
 					// DriverLog("device '%s': section settings changed", m_sSerialNumber.c_str());
 				} break;
@@ -331,7 +368,95 @@ namespace hobovr {
 		}
 
 		virtual void UpdateSectionSettings() {};
-		virtual void RunFrame(std::vector<float> &trackingPacket) = 0;
+
+		// the pose itself comes from the hot state slot, trackingPacket is the device's raw record for everything else
+		virtual void RunFrame(const float* trackingPacket) = 0;
+
+		// binds the device to a slot in the driver's hot state table, pass k_unHotStateIndexInvalid to unbind
+		void AttachHotState(HobovrHotState_t* pHotState, uint32_t unIndex) {
+			m_pHotState = pHotState;
+			m_unHotStateIndex = unIndex;
+		}
+
+		uint32_t GetHotStateIndex() const { return m_unHotStateIndex; }
+
+		// (re)builds the pose template, everything except the streamed values is set here
+		// called on construction and on settings change, derived classes can tweak m_Pose after this (under m_PoseMutex)
+		void ResetPoseTemplate() {
+			std::lock_guard<std::mutex> lock(m_PoseMutex);
+			m_Pose = {};
+			m_Pose.poseTimeOffset = (double)m_fPoseTimeOffset;
+			m_Pose.result = vr::TrackingResult_Running_OK;
+			m_Pose.poseIsValid = true;
+			m_Pose.deviceIsConnected = true;
+			m_Pose.willDriftInYaw = false;
+			m_Pose.shouldApplyHeadModel = true;
+			m_Pose.qWorldFromDriverRotation = {1, 0, 0, 0};
+			m_Pose.qDriverFromHeadRotation = {1, 0, 0, 0};
+			m_Pose.qRotation = {1, 0, 0, 0};
+		}
+
+		// copies the streamed pose values from the hot state slot into the template and submits it
+		// with dynamic pose time offset on, PoseTimeOffset is a bias on top of the measured pose age
+		// does nothing while poses are paced, see SetPosePaced()
+		void SubmitPose() {
+			if (m_pHotState == nullptr || m_bPosePaced)
+				return;
+
+			SubmitPoseFrom(*m_pHotState);
+		}
+
+		// paced mode, poses are submitted by the driver's paced thread from its own table instead of on packet arrival
+		// the table uses the same slot layout as the hot state
+		void SetPosePaced(bool bPaced) {
+			m_bPosePaced = bPaced;
+		}
+
+		void SubmitPacedPose(const HobovrHotState_t& s) {
+			if (m_bPosePaced)
+				SubmitPoseFrom(s);
+		}
+
+		// submits a pose the driver's rate limit held back, the table uses the same slot layout as the hot state
+		// paced devices are limited at the paced thread and never have one
+		void SubmitDeferredPose(const HobovrHotState_t& s) {
+			if (!m_bPosePaced)
+				SubmitPoseFrom(s);
+		}
+
+		// submits the pose in s reported as eResult, for the driver's stream watchdog
+		// works in paced mode too, a stalled device has nothing to pace
+		void SubmitWatchdogPose(const HobovrHotState_t& s, vr::ETrackingResult eResult, bool bPoseIsValid) {
+			SubmitPoseFrom(s, eResult, bPoseIsValid);
+		}
+
+	private:
+		// the receiver and paced threads can both get here, the watchdog's transitions overlap the stream
+		void SubmitPoseFrom(const HobovrHotState_t& s, vr::ETrackingResult eResult = vr::TrackingResult_Running_OK, bool bPoseIsValid = true) {
+			if (m_unHotStateIndex == k_unHotStateIndexInvalid)
+				return;
+
+			std::lock_guard<std::mutex> lock(m_PoseMutex);
+			HotStateLoadPose(s, m_unHotStateIndex, m_Pose);
+			m_Pose.result = eResult;
+			m_Pose.poseIsValid = bPoseIsValid;
+
+			// a predicted pose is ahead of its sample time
+			m_Pose.poseTimeOffset = (double)m_fPoseTimeOffset + (double)s.predictedAhead[m_unHotStateIndex];
+
+			if (m_bDynamicPoseTimeOffset || (s.flags[m_unHotStateIndex] & EHotState_PoserTimed)) {
+				double age = GetSteadySeconds() - s.sampleTime[m_unHotStateIndex];
+				m_Pose.poseTimeOffset -= std::min(std::max(age, 0.0), k_fMaxPoseAgeSeconds);
+			}
+
+			if (m_unObjectId != vr::k_unTrackedDeviceIndexInvalid) {
+				vr::VRServerDriverHost()->TrackedDevicePoseUpdated(
+					m_unObjectId,
+					m_Pose,
+					sizeof(m_Pose)
+				);
+			}
+		}
 
 	protected:
 		// openvr api stuff
@@ -345,10 +470,18 @@ namespace hobovr {
 		std::vector<HobovrComponent_t> m_vComponents; // components that this device has, should be populated in the constructor of the derived class
 
 		float m_fPoseTimeOffset; // time offset of the pose, set trough the config
+		bool m_bDynamicPoseTimeOffset; // subtract the measured pose age from m_fPoseTimeOffset, set trough the config
+
+		std::mutex m_PoseMutex; // guards m_Pose and the pose time offset settings, submits run on the receiver and paced threads
+		vr::DriverPose_t m_Pose; // pose template, only the streamed values change at runtime, see ResetPoseTemplate()
 
 		// hobovr stuff
 		std::shared_ptr<SockReceiver::DriverReceiver> m_pBrodcastSocket;
 
+		HobovrHotState_t* m_pHotState = nullptr; // owned by the server driver, read only for devices
+		uint32_t m_unHotStateIndex = k_unHotStateIndexInvalid; // this device's slot in m_pHotState
+		bool m_bPosePaced = false; // poses come from the paced thread, see SetPosePaced()
+
 	private:
 		// openvr api stuff that i don't trust you to touch
 		vr::VRInputComponentHandle_t m_compHaptic; // haptics, used if UseHaptics is true
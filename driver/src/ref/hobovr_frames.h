@@ -0,0 +1,538 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_FRAMES_H
+#define HOBOVR_FRAMES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hobovr_math.h"
+
+namespace hobovr {
+	// every frame ends with this, it is not part of the payload
+	static const int k_iFrameTerminatorSize = 3; // "\t\r\n"
+
+	// frame magics are quiet NaN bit patterns, so they can never be confused
+	// with the first float of a dense frame, which is a position
+	static const uint32_t k_unFrameMagic_Sparse = 0x7FC0A001;
+	static const uint32_t k_unFrameMagic_Compact = 0x7FC0A002;
+	static const uint32_t k_unFrameMagic_Addressed = 0x7FC0A003;
+	static const uint32_t k_unFrameMagic_InputEvents = 0x7FC0A004;
+	static const uint32_t k_unFrameMagic_Imu = 0x7FC0A005;
+
+	// max input events in a single frame, the rest are dropped
+	static const uint32_t k_unMaxInputEventsPerFrame = 256;
+
+	// max imu samples in a single frame, the rest are dropped
+	static const uint32_t k_unMaxImuSamplesPerFrame = 1024;
+
+	// floats in a controller record: pose(13) + inputs(9)
+	static const int k_iControllerPacketSize = 22;
+	static const uint32_t k_unMaxCompactDevices = 64; // same as the hot state cap
+
+	// dense frame, the original format:
+	//   float record[device][eps[device]] for every udu device, in udu order
+	//
+	// sparse frame, only devices with their bit set in the mask are present:
+	//   HobovrSparseFrameHeader_t
+	//   float record[eps[device]] for every set bit, in ascending device order
+	//
+	// compact frame, quantized sparse frame:
+	//   HobovrCompactFrameHeader_t
+	//   HobovrCompactController_t for every set controller bit, HobovrCompactPose_t for everything else
+	//   in ascending device order, records are packed back to back
+	//   only the standard controller layout is carried, devices with more than k_iControllerPacketSize endpoints
+	//   (extended input schemas) can't be in one, posers send those in a sparse frame alongside
+	//
+	// addressed frame, any subset of devices in any order, each with its own sequence number:
+	//   HobovrAddressedFrameHeader_t
+	//   HobovrAddressedRecordHeader_t + float record[eps[device]], recordCount times
+	//   a device addressed more than once in a frame keeps its last record
+	//
+	// input event frame, controller input changes as they happen, independent of poses:
+	//   HobovrInputEventFrameHeader_t
+	//   HobovrInputEvent_t, eventCount times, oldest first
+	//
+	// imu frame, raw inertial samples and optical position fixes for the driver side fusion, see hobovr_imu_fusion.h:
+	//   HobovrImuFrameHeader_t
+	//   HobovrImuSample_t, sampleCount times, oldest first
+#pragma pack(push, 1)
+	struct HobovrSparseFrameHeader_t {
+		uint32_t magic; // k_unFrameMagic_Sparse
+		uint32_t maskLo; // devices 0-31
+		uint32_t maskHi; // devices 32-63
+		float sampleAge; // seconds between the newest sample in the frame being taken and the frame being sent, 0 if unknown
+	};
+
+	struct HobovrCompactFrameHeader_t {
+		uint32_t magic; // k_unFrameMagic_Compact
+		uint32_t maskLo; // devices 0-31
+		uint32_t maskHi; // devices 32-63
+		float positionRange; // positions are fixed point in [-positionRange, positionRange] meters
+	};
+
+	struct HobovrCompactPose_t {
+		int16_t pos[3]; // pos/positionRange*32767
+		uint32_t rot; // smallest three: largest component index in bits 30-31, the other three as 10 bit [0, 1022] mapped onto [-1/sqrt(2), 1/sqrt(2)]
+		uint16_t vel[3]; // half floats
+		uint16_t angVel[3]; // half floats
+	}; // 22 bytes
+
+	struct HobovrCompactController_t {
+		HobovrCompactPose_t pose;
+		uint8_t buttons; // bit 0 grip, 1 system, 2 menu, 3 trackpad click, 4 trackpad touch, 5 trigger click
+		uint16_t axes[3]; // half floats: trigger value, trackpad x, trackpad y
+	}; // 29 bytes
+
+	struct HobovrAddressedFrameHeader_t {
+		uint32_t magic; // k_unFrameMagic_Addressed
+		uint32_t recordCount;
+	};
+
+	struct HobovrAddressedRecordHeader_t {
+		uint16_t device; // udu index
+		uint16_t sequence; // per device, incremented by one for every record sent to that device
+		float sampleAge; // seconds between the sample being taken and the frame being sent, 0 if unknown
+	};
+
+	struct HobovrInputEventFrameHeader_t {
+		uint32_t magic; // k_unFrameMagic_InputEvents
+		uint32_t eventCount;
+	};
+
+	struct HobovrInputEvent_t {
+		uint16_t device; // udu index, has to be a controller
+		uint8_t type; // EHobovrInputEventType
+		uint8_t axis; // EHobovrInputEventAxis, axis events only
+		float sampleAge; // seconds between the input changing and the frame being sent
+		uint16_t buttons; // button events only, EHobovrInputEventButton bits, state of every button
+		uint16_t changed; // button events only, EHobovrInputEventButton bits, which buttons changed
+		float value; // axis events only
+	}; // 16 bytes
+
+	struct HobovrImuFrameHeader_t {
+		uint32_t magic; // k_unFrameMagic_Imu
+		uint32_t sampleCount;
+	};
+
+	struct HobovrImuSample_t {
+		uint16_t device; // udu index
+		uint8_t type; // EHobovrImuSampleType
+		uint8_t reserved;
+		float sampleAge; // seconds between the sample being taken and the frame being sent
+		float a[3]; // inertial: gyro, rad/s, device frame; optical: position, meters, driver space
+		float b[3]; // inertial: accelerometer, m/s^2, device frame, reads +g up at rest; optical: b[0] is the position std dev in meters, 0 for the default
+	}; // 32 bytes
+#pragma pack(pop)
+
+	enum EHobovrImuSampleType {
+		EHobovrImuSample_Inertial = 0,
+		EHobovrImuSample_Optical = 1,
+	};
+
+	enum EHobovrInputEventType {
+		EHobovrInputEvent_Buttons = 0,
+		EHobovrInputEvent_Axis = 1,
+	};
+
+	// same bit order as the compact controller record and the default input schema
+	// with a custom schema, bit i is the i-th boolean and axis i the i-th scalar, see hobovr_input_schema.h
+	enum EHobovrInputEventButton {
+		EHobovrInputButton_Grip = 1 << 0,
+		EHobovrInputButton_System = 1 << 1,
+		EHobovrInputButton_Menu = 1 << 2,
+		EHobovrInputButton_TrackpadClick = 1 << 3,
+		EHobovrInputButton_TrackpadTouch = 1 << 4,
+		EHobovrInputButton_TriggerClick = 1 << 5,
+	};
+
+	enum EHobovrInputEventAxis {
+		EHobovrInputAxis_Trigger = 0,
+		EHobovrInputAxis_TrackpadX = 1,
+		EHobovrInputAxis_TrackpadY = 2,
+	};
+
+	// branch free half/fixed point/smallest three decoders, 4 values at a time
+	// inputs are widened to 32 bit lanes
+#ifdef HOBOVR_USE_SSE2
+	inline __m128 HalfToFloat4(__m128i h) {
+		const __m128i maskNoSign = _mm_set1_epi32(0x7fff);
+		const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+		const __m128i wasInfNan = _mm_set1_epi32(0x7bff);
+		const __m128i expInfNan = _mm_set1_epi32(255 << 23);
+
+		__m128i expmant = _mm_and_si128(maskNoSign, h);
+		__m128i justsign = _mm_xor_si128(h, expmant);
+		__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), magic); // rebias exponent, handles denormals too
+		__m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, wasInfNan), expInfNan);
+		__m128i sign = _mm_slli_epi32(justsign, 16);
+		return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infnan)));
+	}
+
+	// rot is 4 packed smallest three quaternions, outputs are 4 quaternions as structure of arrays
+	inline void SmallestThreeToQuat4(__m128i rot, __m128& w, __m128& x, __m128& y, __m128& z) {
+		const __m128i mask10 = _mm_set1_epi32(0x3ff);
+		const __m128 scale = _mm_set1_ps(1.41421356f / 1022.f); // [0, 1022] -> [0, sqrt(2)], 511 is exactly 0
+		const __m128 bias = _mm_set1_ps(0.70710678f);
+
+		__m128i idx = _mm_srli_epi32(rot, 30);
+		__m128 a = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rot, 20), mask10)), scale), bias);
+		__m128 b = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rot, 10), mask10)), scale), bias);
+		__m128 c = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(rot, mask10)), scale), bias);
+		__m128 d2 = _mm_sub_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c)));
+		__m128 d = _mm_sqrt_ps(_mm_max_ps(d2, _mm_setzero_ps()));
+
+		__m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(0)));
+		__m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(1)));
+		__m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(2)));
+		__m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(3)));
+		auto sel = [](__m128 m, __m128 t, __m128 f) { return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f)); };
+
+		// idx 0: (d, a, b, c), 1: (a, d, b, c), 2: (a, b, d, c), 3: (a, b, c, d)
+		w = sel(is0, d, a);
+		x = sel(is0, a, sel(is1, d, b));
+		y = sel(_mm_or_ps(is0, is1), b, sel(is2, d, c));
+		z = sel(is3, d, c);
+	}
+#endif
+
+	inline float HalfToFloat(uint16_t h) {
+		uint32_t expmant = h & 0x7fff;
+		uint32_t bits = (expmant << 13);
+		float scaled;
+		memcpy(&scaled, &bits, sizeof(scaled));
+		scaled *= 5.192296858534828e+33f; // 2^112, rebias exponent, handles denormals too
+		memcpy(&bits, &scaled, sizeof(bits));
+		bits |= (uint32_t)(h & 0x8000) << 16;
+		bits |= (expmant > 0x7bff) ? (255u << 23) : 0u;
+		float out;
+		memcpy(&out, &bits, sizeof(out));
+		return out;
+	}
+
+	inline void SmallestThreeToQuat(uint32_t rot, float* q) {
+		const float scale = 1.41421356f / 1022.f;
+		uint32_t idx = rot >> 30;
+		float a = (float)((rot >> 20) & 0x3ff) * scale - 0.70710678f;
+		float b = (float)((rot >> 10) & 0x3ff) * scale - 0.70710678f;
+		float c = (float)(rot & 0x3ff) * scale - 0.70710678f;
+		float d = std::sqrt(std::max(1.f - a*a - b*b - c*c, 0.f));
+
+		// q[idx] = d, the rest in order, indexed so no branches are needed
+		float t[4] = {a, b, c, 0.f};
+		for (uint32_t i = 0; i < 4; i++)
+			q[i] = t[i - (i > idx)];
+		q[idx] = d;
+	}
+
+	// returns the frame magic or 0 if the frame has none
+	inline uint32_t GetFrameMagic(const char* buff, int len) {
+		if (len < (int)sizeof(uint32_t) + k_iFrameTerminatorSize)
+			return 0;
+
+		uint32_t magic;
+		memcpy(&magic, buff, sizeof(magic));
+		return (magic & 0xFFFFFF00) == 0x7FC0A000 ? magic : 0;
+	}
+
+	// for logs, frames with no or an unknown magic are decoded as dense ones
+	inline const char* GetFrameName(uint32_t magic) {
+		switch (magic) {
+			case k_unFrameMagic_Sparse: return "sparse";
+			case k_unFrameMagic_Compact: return "compact";
+			case k_unFrameMagic_Addressed: return "addressed";
+			case k_unFrameMagic_InputEvents: return "input event";
+			case k_unFrameMagic_Imu: return "imu";
+			default: return "dense";
+		}
+	}
+
+	// frame decoders, on success records[i] points at device i's record or is nullptr if device i is not in the frame
+	// eps[i] is the record size of device i in floats, only the first count devices are decoded
+
+	inline bool DecodeDenseFrame(const char* buff, int len, const std::vector<int>& eps, uint32_t count, const float** records) {
+		int expected = 0;
+		for (auto i : eps)
+			expected += i;
+
+		if (len != expected*(int)sizeof(float) + k_iFrameTerminatorSize)
+			return false;
+
+		const float* packet = (const float*)buff;
+		int offset = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			records[i] = packet + offset;
+			offset += eps[i];
+		}
+
+		return true;
+	}
+
+	// sampleAge is the frame's sample age in seconds, clamped like AddressedSampleAge, 0 if the poser didn't know it
+	inline bool DecodeSparseFrame(const char* buff, int len, const std::vector<int>& eps, uint32_t count, const float** records, double& sampleAge) {
+		if (len < (int)sizeof(HobovrSparseFrameHeader_t) + k_iFrameTerminatorSize)
+			return false;
+
+		HobovrSparseFrameHeader_t header;
+		memcpy(&header, buff, sizeof(header));
+		sampleAge = header.sampleAge > 0.f ? (double)std::min(header.sampleAge, 1.f) : 0.0; // NaN fails the compare too
+		uint64_t mask = ((uint64_t)header.maskHi << 32) | header.maskLo;
+
+		if (count < 64 && (mask >> count))
+			return false; // addresses devices that don't exist
+
+		const float* packet = (const float*)(buff + sizeof(header));
+		int offset = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			if ((mask >> i) & 1) {
+				records[i] = packet + offset;
+				offset += eps[i];
+			} else {
+				records[i] = nullptr;
+			}
+		}
+
+		return len == (int)sizeof(header) + offset*(int)sizeof(float) + k_iFrameTerminatorSize;
+	}
+
+	// recordHeaders[i] is filled for every device that got a record
+	inline bool DecodeAddressedFrame(const char* buff, int len, const std::vector<int>& eps, uint32_t count,
+		const float** records, HobovrAddressedRecordHeader_t* recordHeaders) {
+		if (len < (int)sizeof(HobovrAddressedFrameHeader_t) + k_iFrameTerminatorSize)
+			return false;
+
+		HobovrAddressedFrameHeader_t header;
+		memcpy(&header, buff, sizeof(header));
+
+		for (uint32_t i = 0; i < count; i++)
+			records[i] = nullptr;
+
+		const char* cursor = buff + sizeof(header);
+		const char* end = buff + len - k_iFrameTerminatorSize;
+		for (uint32_t r = 0; r < header.recordCount; r++) {
+			if (cursor + sizeof(HobovrAddressedRecordHeader_t) > end)
+				return false;
+
+			HobovrAddressedRecordHeader_t recordHeader;
+			memcpy(&recordHeader, cursor, sizeof(recordHeader));
+			cursor += sizeof(recordHeader);
+
+			if (recordHeader.device >= count)
+				return false; // addresses a device that doesn't exist
+
+			int recordSize = eps[recordHeader.device]*(int)sizeof(float);
+			if (cursor + recordSize > end)
+				return false;
+
+			records[recordHeader.device] = (const float*)cursor;
+			recordHeaders[recordHeader.device] = recordHeader;
+			cursor += recordSize;
+		}
+
+		return cursor == end;
+	}
+
+	// copies the events out of the frame, events past maxEvents are dropped
+	// device indices are not checked here, every event has to be checked against the device list
+	inline bool DecodeInputEventFrame(const char* buff, int len, HobovrInputEvent_t* events, uint32_t maxEvents, uint32_t& eventCount) {
+		eventCount = 0;
+		if (len < (int)sizeof(HobovrInputEventFrameHeader_t) + k_iFrameTerminatorSize)
+			return false;
+
+		HobovrInputEventFrameHeader_t header;
+		memcpy(&header, buff, sizeof(header));
+
+		if ((uint64_t)len != sizeof(header) + (uint64_t)header.eventCount*sizeof(HobovrInputEvent_t) + k_iFrameTerminatorSize)
+			return false;
+
+		eventCount = std::min(header.eventCount, maxEvents);
+		memcpy(events, buff + sizeof(header), eventCount*sizeof(HobovrInputEvent_t));
+		return true;
+	}
+
+	// copies the samples out of the frame, samples past maxSamples are dropped
+	// device indices are not checked here
+	inline bool DecodeImuFrame(const char* buff, int len, HobovrImuSample_t* samples, uint32_t maxSamples, uint32_t& sampleCount) {
+		sampleCount = 0;
+		if (len < (int)sizeof(HobovrImuFrameHeader_t) + k_iFrameTerminatorSize)
+			return false;
+
+		HobovrImuFrameHeader_t header;
+		memcpy(&header, buff, sizeof(header));
+
+		if ((uint64_t)len != sizeof(header) + (uint64_t)header.sampleCount*sizeof(HobovrImuSample_t) + k_iFrameTerminatorSize)
+			return false;
+
+		sampleCount = std::min(header.sampleCount, maxSamples);
+		memcpy(samples, buff + sizeof(header), sampleCount*sizeof(HobovrImuSample_t));
+		return true;
+	}
+
+	// largest frame the decoders take for a udu list of iDenseFloats floats in total, receive buffers are sized from this
+	// addressed frames are covered with every device present once, input event and imu frames up to their per frame caps
+	inline int MaxFrameBytes(int iDenseFloats) {
+		int dense = iDenseFloats*4;
+		int sparse = (int)sizeof(HobovrSparseFrameHeader_t) + dense;
+		int compact = (int)(sizeof(HobovrCompactFrameHeader_t) + k_unMaxCompactDevices*sizeof(HobovrCompactController_t));
+		int addressed = (int)(sizeof(HobovrAddressedFrameHeader_t) + k_unMaxCompactDevices*sizeof(HobovrAddressedRecordHeader_t)) + dense;
+		int events = (int)(sizeof(HobovrInputEventFrameHeader_t) + k_unMaxInputEventsPerFrame*sizeof(HobovrInputEvent_t));
+		int imu = (int)(sizeof(HobovrImuFrameHeader_t) + k_unMaxImuSamplesPerFrame*sizeof(HobovrImuSample_t));
+
+		return std::max({dense, sparse, compact, addressed, events, imu}) + k_iFrameTerminatorSize;
+	}
+
+	// seconds since an imu sample was taken, same clamping as AddressedSampleAge
+	inline double ImuSampleAge(const HobovrImuSample_t& sample) {
+		float age = sample.sampleAge;
+		return age > 0.f ? (double)std::min(age, 1.f) : 0.0;
+	}
+
+	// seconds since an input event happened, same clamping as AddressedSampleAge
+	inline double InputEventAge(const HobovrInputEvent_t& event) {
+		float age = event.sampleAge;
+		return age > 0.f ? (double)std::min(age, 1.f) : 0.0;
+	}
+
+	// sample age of an addressed record in seconds, garbage and absurd values are clamped to [0, 1]
+	inline double AddressedSampleAge(const HobovrAddressedRecordHeader_t& recordHeader) {
+		float age = recordHeader.sampleAge;
+		return age > 0.f ? (double)std::min(age, 1.f) : 0.0; // NaN fails the compare too
+	}
+
+	// compact frames are expanded into dense float records in scratch, scratchStride floats per device
+	// scratchStride has to be at least k_iControllerPacketSize, floats past the controller record are zeroed
+	// devices with eps over scratchStride can't be sent compact, a frame addressing one is rejected as a whole
+	inline bool DecodeCompactFrame(const char* buff, int len, const std::vector<std::string>& devices, const std::vector<int>& eps,
+		uint32_t count, float* scratch, int scratchStride, const float** records) {
+		if (len < (int)sizeof(HobovrCompactFrameHeader_t) + k_iFrameTerminatorSize)
+			return false;
+
+		HobovrCompactFrameHeader_t header;
+		memcpy(&header, buff, sizeof(header));
+		uint64_t mask = ((uint64_t)header.maskHi << 32) | header.maskLo;
+
+		if (scratchStride < k_iControllerPacketSize || count > k_unMaxCompactDevices || (count < 64 && (mask >> count)))
+			return false; // addresses devices that don't exist
+
+		// gather the quantized fields into structure of arrays staging
+		alignas(16) int32_t pos[3][k_unMaxCompactDevices];
+		alignas(16) uint32_t rot[k_unMaxCompactDevices];
+		alignas(16) int32_t halfs[9][k_unMaxCompactDevices]; // vel, ang vel, axes
+		alignas(16) uint32_t buttons[k_unMaxCompactDevices];
+		uint32_t slots[k_unMaxCompactDevices];
+		uint32_t n = 0;
+
+		const char* cursor = buff + sizeof(header);
+		const char* end = buff + len - k_iFrameTerminatorSize;
+		for (uint32_t i = 0; i < count; i++) {
+			records[i] = nullptr;
+			if (!((mask >> i) & 1))
+				continue;
+
+			bool isController = devices[i] == "c";
+			int recordSize = isController ? (int)sizeof(HobovrCompactController_t) : (int)sizeof(HobovrCompactPose_t);
+			if (cursor + recordSize > end || eps[i] > scratchStride)
+				return false;
+
+			HobovrCompactController_t rec = {};
+			memcpy(&rec, cursor, recordSize);
+			cursor += recordSize;
+
+			for (int k = 0; k < 3; k++) {
+				pos[k][n] = rec.pose.pos[k];
+				halfs[k][n] = rec.pose.vel[k];
+				halfs[3 + k][n] = rec.pose.angVel[k];
+				halfs[6 + k][n] = rec.axes[k];
+			}
+			rot[n] = rec.pose.rot;
+			buttons[n] = rec.buttons;
+			slots[n] = i;
+			n++;
+		}
+
+		if (cursor != end)
+			return false;
+
+		// pad the staging to a multiple of 4 so the vector loop can run over it
+		for (uint32_t j = n; j < ((n + 3u) & ~3u); j++) {
+			for (int k = 0; k < 3; k++)
+				pos[k][j] = 0;
+			for (int k = 0; k < 9; k++)
+				halfs[k][j] = 0;
+			rot[j] = 0;
+		}
+
+		alignas(16) float out[k_iControllerPacketSize][k_unMaxCompactDevices];
+		float posScale = header.positionRange / 32767.f;
+
+#ifdef HOBOVR_USE_SSE2
+		__m128 vPosScale = _mm_set1_ps(posScale);
+		for (uint32_t j = 0; j < n; j += 4) {
+			for (int k = 0; k < 3; k++)
+				_mm_store_ps(&out[k][j], _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((const __m128i*)&pos[k][j])), vPosScale));
+
+			__m128 w, x, y, z;
+			SmallestThreeToQuat4(_mm_load_si128((const __m128i*)&rot[j]), w, x, y, z);
+			_mm_store_ps(&out[3][j], w);
+			_mm_store_ps(&out[4][j], x);
+			_mm_store_ps(&out[5][j], y);
+			_mm_store_ps(&out[6][j], z);
+
+			for (int k = 0; k < 6; k++)
+				_mm_store_ps(&out[7 + k][j], HalfToFloat4(_mm_load_si128((const __m128i*)&halfs[k][j])));
+
+			for (int k = 0; k < 3; k++)
+				_mm_store_ps(&out[17 + k][j], HalfToFloat4(_mm_load_si128((const __m128i*)&halfs[6 + k][j])));
+		}
+#else
+		for (uint32_t j = 0; j < n; j++) {
+			for (int k = 0; k < 3; k++)
+				out[k][j] = (float)pos[k][j] * posScale;
+
+			float q[4];
+			SmallestThreeToQuat(rot[j], q);
+			for (int k = 0; k < 4; k++)
+				out[3 + k][j] = q[k];
+
+			for (int k = 0; k < 6; k++)
+				out[7 + k][j] = HalfToFloat((uint16_t)halfs[k][j]);
+
+			for (int k = 0; k < 3; k++)
+				out[17 + k][j] = HalfToFloat((uint16_t)halfs[6 + k][j]);
+		}
+#endif
+
+		// buttons, in the same order as the dense controller record
+		for (uint32_t j = 0; j < n; j++) {
+			out[13][j] = (float)(buttons[j] & 1); // grip
+			out[14][j] = (float)((buttons[j] >> 1) & 1); // system
+			out[15][j] = (float)((buttons[j] >> 2) & 1); // menu
+			out[16][j] = (float)((buttons[j] >> 3) & 1); // trackpad click
+			out[20][j] = (float)((buttons[j] >> 4) & 1); // trackpad touch
+			out[21][j] = (float)((buttons[j] >> 5) & 1); // trigger click
+		}
+
+		// scatter into per device float records
+		for (uint32_t j = 0; j < n; j++) {
+			float* record = scratch + slots[j]*scratchStride;
+			for (int k = 0; k < k_iControllerPacketSize; k++)
+				record[k] = out[k][j];
+			for (int k = k_iControllerPacketSize; k < scratchStride; k++)
+				record[k] = 0.f;
+
+			records[slots[j]] = record;
+		}
+
+		return true;
+	}
+}
+
+#endif // HOBOVR_FRAMES_H
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_HOT_STATE_H
+#define HOBOVR_HOT_STATE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "hobovr_math.h"
+
+namespace hobovr {
+	// hard cap on the number of udu devices, the hot state table is sized by this
+	static const uint32_t k_unMaxHotStateDevices = 64;
+	static const uint32_t k_unHotStateIndexInvalid = 0xFFFFFFFF;
+
+	// smoothing of the measured per device update interval
+	static const float k_fUpdateIntervalEmaAlpha = 0.05f;
+
+	// sequence numbers this far behind the last one are taken as a poser restart, not a stale frame
+	static const int k_iSequenceResyncWindow = 256;
+
+	enum EHotStateFlags {
+		EHotState_Active = 1 << 0, // slot is used by a device
+		EHotState_Updated = 1 << 1, // slot got a new sample this frame
+		EHotState_PoserTimed = 1 << 2, // the sample time of the slot's latest sample came from a poser side sample age
+	};
+
+	// steady clock time in seconds, all hot state timestamps use this time base
+	inline double ToSteadySeconds(std::chrono::steady_clock::time_point t) {
+		return std::chrono::duration<double>(t.time_since_epoch()).count();
+	}
+
+	inline double GetSteadySeconds() {
+		return ToSteadySeconds(std::chrono::steady_clock::now());
+	}
+
+	// relaxed atomic counter, the receiver, pool and paced threads count, the slow update thread reads
+	// copies are a plain load so the stats can still be snapshotted and compared
+	struct HobovrStatCounter_t {
+		HobovrStatCounter_t() = default;
+		HobovrStatCounter_t(const HobovrStatCounter_t& o) : value(o.load()) {}
+
+		HobovrStatCounter_t& operator=(const HobovrStatCounter_t& o) {
+			value.store(o.load(), std::memory_order_relaxed);
+			return *this;
+		}
+
+		void operator++(int) { value.fetch_add(1, std::memory_order_relaxed); }
+		void operator+=(uint32_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+		uint32_t load() const { return value.load(std::memory_order_relaxed); }
+
+		std::atomic<uint32_t> value{0};
+	};
+
+	// per device counters, cold data, only touched when something goes wrong
+	struct HobovrDeviceStats_t {
+		HobovrStatCounter_t quatRenormalized; // non unit quaternions that got normalized
+		HobovrStatCounter_t quatRejected; // zero length or NaN/Inf quaternions, last good pose was used instead
+		HobovrStatCounter_t posRejected; // NaN/Inf positions, last good pose was used instead
+		HobovrStatCounter_t velClamped; // NaN/Inf or absurd velocities that got zeroed or clamped
+		HobovrStatCounter_t framesDropped; // gaps in the sequence numbers of addressed frames
+		HobovrStatCounter_t framesOutOfOrder; // stale or repeated addressed frames that got rejected
+		HobovrStatCounter_t outliersRejected; // implausible jumps replaced by the last good pose
+		HobovrStatCounter_t outliersReacquired; // jumps accepted after enough samples agreed on the new location
+		HobovrStatCounter_t streamStalls; // times the stream went quiet and the pose got dead reckoned
+		HobovrStatCounter_t streamLost; // stalls that lasted long enough to report the device out of range
+	};
+
+	inline bool HotStateStatsEqual(const HobovrDeviceStats_t& a, const HobovrDeviceStats_t& b) {
+		return a.quatRenormalized.load() == b.quatRenormalized.load()
+			&& a.quatRejected.load() == b.quatRejected.load()
+			&& a.posRejected.load() == b.posRejected.load()
+			&& a.velClamped.load() == b.velClamped.load()
+			&& a.framesDropped.load() == b.framesDropped.load()
+			&& a.framesOutOfOrder.load() == b.framesOutOfOrder.load()
+			&& a.outliersRejected.load() == b.outliersRejected.load()
+			&& a.outliersReacquired.load() == b.outliersReacquired.load()
+			&& a.streamStalls.load() == b.streamStalls.load()
+			&& a.streamLost.load() == b.streamLost.load();
+	}
+
+	// per device link state, cold data, only touched when a sample arrives
+	struct HobovrDeviceLink_t {
+		float updateInterval; // smoothed seconds between samples, 0 until measured
+		uint16_t lastSequence; // last accepted addressed frame sequence number
+		bool hasSequence; // lastSequence is valid
+	};
+
+	// per frame state of all devices as a structure of arrays
+	// every array is cache line aligned so per frame passes can run over contiguous memory
+	// slot index == position of the device in the udu list
+	struct alignas(64) HobovrHotState_t {
+		alignas(64) float posX[k_unMaxHotStateDevices];
+		alignas(64) float posY[k_unMaxHotStateDevices];
+		alignas(64) float posZ[k_unMaxHotStateDevices];
+
+		alignas(64) float rotW[k_unMaxHotStateDevices];
+		alignas(64) float rotX[k_unMaxHotStateDevices];
+		alignas(64) float rotY[k_unMaxHotStateDevices];
+		alignas(64) float rotZ[k_unMaxHotStateDevices];
+
+		alignas(64) float velX[k_unMaxHotStateDevices];
+		alignas(64) float velY[k_unMaxHotStateDevices];
+		alignas(64) float velZ[k_unMaxHotStateDevices];
+
+		alignas(64) float angVelX[k_unMaxHotStateDevices];
+		alignas(64) float angVelY[k_unMaxHotStateDevices];
+		alignas(64) float angVelZ[k_unMaxHotStateDevices];
+
+		alignas(64) double sampleTime[k_unMaxHotStateDevices]; // when the sample was taken, see GetSteadySeconds()
+		alignas(64) float predictedAhead[k_unMaxHotStateDevices]; // seconds the pose was moved past sampleTime by prediction
+		alignas(64) uint32_t flags[k_unMaxHotStateDevices]; // EHotStateFlags
+
+		uint32_t count = 0; // number of used slots, slots [0, count) are valid
+
+		// kept last, not part of the per frame passes
+		HobovrDeviceStats_t stats[k_unMaxHotStateDevices];
+		HobovrDeviceLink_t link[k_unMaxHotStateDevices];
+	};
+
+	// scatters a streamed pose packet into slot i
+	// bPoserTimed is for sample times the poser's sample age went into, not just the arrival time
+	inline void HotStateStorePacket(HobovrHotState_t& s, uint32_t i, const float* packet, double sampleTime, bool bPoserTimed = false) {
+		HobovrDeviceLink_t& link = s.link[i];
+		float dt = (float)(sampleTime - s.sampleTime[i]);
+		if (s.sampleTime[i] > 0.0 && dt > 0.f)
+			link.updateInterval = link.updateInterval > 0.f ? link.updateInterval + (dt - link.updateInterval)*k_fUpdateIntervalEmaAlpha : dt;
+
+		s.posX[i] = packet[0];
+		s.posY[i] = packet[1];
+		s.posZ[i] = packet[2];
+
+		s.rotW[i] = packet[3];
+		s.rotX[i] = packet[4];
+		s.rotY[i] = packet[5];
+		s.rotZ[i] = packet[6];
+
+		s.velX[i] = packet[7];
+		s.velY[i] = packet[8];
+		s.velZ[i] = packet[9];
+
+		s.angVelX[i] = packet[10];
+		s.angVelY[i] = packet[11];
+		s.angVelZ[i] = packet[12];
+
+		s.sampleTime[i] = sampleTime;
+		s.flags[i] = bPoserTimed ? (s.flags[i] | EHotState_PoserTimed) : (s.flags[i] & ~EHotState_PoserTimed);
+		s.flags[i] |= EHotState_Updated;
+	}
+
+	// gathers slot i back into the streamed values of a driver pose
+	inline void HotStateLoadPose(const HobovrHotState_t& s, uint32_t i, vr::DriverPose_t& pose) {
+		float packet[k_iPosePacketSize] = {
+			s.posX[i], s.posY[i], s.posZ[i],
+			s.rotW[i], s.rotX[i], s.rotY[i], s.rotZ[i],
+			s.velX[i], s.velY[i], s.velZ[i],
+			s.angVelX[i], s.angVelY[i], s.angVelZ[i]
+		};
+		PosePacketToDriverPose(pose, packet);
+	}
+
+	inline void HotStateClearSlot(HobovrHotState_t& s, uint32_t i) {
+		s.posX[i] = s.posY[i] = s.posZ[i] = 0.f;
+		s.rotW[i] = 1.f;
+		s.rotX[i] = s.rotY[i] = s.rotZ[i] = 0.f;
+		s.velX[i] = s.velY[i] = s.velZ[i] = 0.f;
+		s.angVelX[i] = s.angVelY[i] = s.angVelZ[i] = 0.f;
+		s.sampleTime[i] = 0.0;
+		s.predictedAhead[i] = 0.f;
+		s.flags[i] = 0;
+		s.stats[i] = {};
+		s.link[i] = {};
+	}
+
+	// sequence check for addressed frames, returns false if the sample is stale and has to be dropped
+	// int16 differences so the counters can wrap
+	inline bool HotStateAcceptSequence(HobovrHotState_t& s, uint32_t i, uint16_t sequence) {
+		HobovrDeviceLink_t& link = s.link[i];
+		int d = (int16_t)(uint16_t)(sequence - link.lastSequence);
+
+		if (link.hasSequence && d <= 0 && d > -k_iSequenceResyncWindow) {
+			s.stats[i].framesOutOfOrder++;
+			return false;
+		}
+
+		if (link.hasSequence && d > 1)
+			s.stats[i].framesDropped += d - 1;
+
+		link.lastSequence = sequence;
+		link.hasSequence = true;
+		return true;
+	}
+
+	// measured update rate of slot i in Hz, 0 if not known yet
+	inline float HotStateUpdateRate(const HobovrHotState_t& s, uint32_t i) {
+		return s.link[i].updateInterval > 0.f ? 1.f / s.link[i].updateInterval : 0.f;
+	}
+
+	// formats slot i's counters for logs and debug requests
+	inline int HotStateFormatStats(const HobovrHotState_t& s, uint32_t i, char* buff, uint32_t size) {
+		const HobovrDeviceStats_t& st = s.stats[i];
+		double age = s.sampleTime[i] > 0.0 ? GetSteadySeconds() - s.sampleTime[i] : -1.0;
+		return snprintf(buff, size,
+			"quat renormalized %u, quat rejected %u, pos rejected %u, vel clamped %u, "
+			"dropped %u, out of order %u, outliers %u, reacquired %u, stalls %u, lost %u, rate %.1f Hz, last sample %.1f ms ago",
+			st.quatRenormalized.load(),
+			st.quatRejected.load(),
+			st.posRejected.load(),
+			st.velClamped.load(),
+			st.framesDropped.load(),
+			st.framesOutOfOrder.load(),
+			st.outliersRejected.load(),
+			st.outliersReacquired.load(),
+			st.streamStalls.load(),
+			st.streamLost.load(),
+			HotStateUpdateRate(s, i),
+			age*1000.0
+		);
+	}
+
+	// marks slots [0, count) as active and resets the rest
+	inline void HotStateResize(HobovrHotState_t& s, uint32_t count) {
+		for (uint32_t i = count; i < k_unMaxHotStateDevices; i++)
+			HotStateClearSlot(s, i);
+
+		for (uint32_t i = s.count; i < count; i++)
+			HotStateClearSlot(s, i);
+
+		for (uint32_t i = 0; i < count; i++)
+			s.flags[i] |= EHotState_Active;
+
+		s.count = count;
+	}
+}
+
+#endif // HOBOVR_HOT_STATE_H
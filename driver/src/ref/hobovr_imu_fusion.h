@@ -0,0 +1,535 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_IMU_FUSION_H
+#define HOBOVR_IMU_FUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "hobovr_frames.h"
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// noise densities, driver wide
+	static const char *const k_pch_Hobovr_ImuGyroNoise_Float = "ImuGyroNoise"; // rad/s/sqrt(Hz)
+	static const char *const k_pch_Hobovr_ImuAccelNoise_Float = "ImuAccelNoise"; // m/s^2/sqrt(Hz)
+	static const char *const k_pch_Hobovr_ImuGyroBiasWalk_Float = "ImuGyroBiasWalk"; // rad/s^2/sqrt(Hz)
+	static const char *const k_pch_Hobovr_ImuAccelBiasWalk_Float = "ImuAccelBiasWalk"; // m/s^3/sqrt(Hz)
+	static const char *const k_pch_Hobovr_ImuOpticalNoise_Float = "ImuOpticalNoise"; // m, default optical fix std dev
+
+	static const float k_fImuGravity = 9.80665f; // driver space is y up
+
+	// inertial samples averaged at the start for gravity alignment and the initial gyro bias, the device has to be at rest
+	static const uint32_t k_unImuAlignSamples = 50;
+
+	// no inertial samples for this long and the slot falls back to pose records, the filter restarts when they come back
+	static const double k_fImuTimeout = 0.25;
+
+	// no optical fixes for this long and the position is held, orientation only
+	static const double k_fImuOpticalTimeout = 1.0;
+
+	// tilt correction from the accelerometer while there are no optical fixes, only while it reads gravity within this much
+	static const float k_fImuGravityGate = 0.5f; // m/s^2
+	static const float k_fImuGravityNoise = 1.f; // m/s^2, covers the accelerations that pass the gate
+	static const uint32_t k_unImuGravityStride = 10; // every n-th inertial sample, tilt drifts slowly
+
+	struct HobovrImuNoise_t {
+		float fGyro;
+		float fAccel;
+		float fGyroBiasWalk;
+		float fAccelBiasWalk;
+		float fOptical;
+	};
+
+	// error state extended kalman filter for one device
+	// nominal state: position, velocity, rotation (device to driver space), gyro bias, accelerometer bias
+	// error state: dp, dv, dtheta (device frame), dbg, dba, 15 floats, covariance is dense
+	// inertial samples propagate, optical positions and the accelerometer's gravity reading correct
+	class HobovrImuFilter {
+	public:
+		enum {
+			k_iP = 0, k_iV = 3, k_iTheta = 6, k_iBg = 9, k_iBa = 12,
+			k_iN = 15,
+		};
+
+		void Reset() {
+			m_unAlignCount = 0;
+			memset(m_vAlignGyro, 0, sizeof(m_vAlignGyro));
+			memset(m_vAlignAccel, 0, sizeof(m_vAlignAccel));
+			m_bAligned = false;
+			m_bHasPosition = false;
+			m_fLastInertialTime = 0.0;
+			m_fLastOpticalTime = 0.0;
+			m_unGravityCounter = 0;
+		}
+
+		void SetNoise(const HobovrImuNoise_t& noise) {
+			m_Noise = noise;
+		}
+
+		bool IsActive(double now) const {
+			return m_fLastInertialTime > 0.0 && now - m_fLastInertialTime < k_fImuTimeout;
+		}
+
+		bool IsAligned() const { return m_bAligned; }
+
+		void AddInertial(double t, const float* gyro, const float* accel) {
+			double dt = t - m_fLastInertialTime;
+			if (m_fLastInertialTime > 0.0 && dt > k_fImuTimeout)
+				Reset(); // gap, the state is too old to continue from
+
+			if (m_fLastInertialTime > 0.0 && dt <= 0.0)
+				return; // stale or repeated sample
+
+			bool bFirst = m_fLastInertialTime <= 0.0;
+			m_fLastInertialTime = t;
+			m_vGyro[0] = gyro[0]; m_vGyro[1] = gyro[1]; m_vGyro[2] = gyro[2];
+
+			if (!m_bAligned) {
+				Align(gyro, accel);
+				return;
+			}
+
+			if (bFirst)
+				return;
+
+			Propagate(gyro, accel, (float)dt);
+
+			// with optical fixes tilt is observable through the position, the accelerometer is only trusted without them
+			bool bHeld = m_fLastInertialTime - m_fLastOpticalTime > k_fImuOpticalTimeout;
+			if (bHeld && ++m_unGravityCounter >= k_unImuGravityStride) {
+				m_unGravityCounter = 0;
+				GravityUpdate(accel);
+			}
+		}
+
+		void AddOptical(double t, const float* pos, float fStdDev) {
+			bool bHeld = !m_bHasPosition || t - m_fLastOpticalTime > k_fImuOpticalTimeout;
+			m_fLastOpticalTime = std::max(m_fLastOpticalTime, t);
+
+			if (bHeld || !m_bAligned) {
+				// nothing to correct, take the fix as is
+				m_bHasPosition = true;
+				for (int j = 0; j < 3; j++) {
+					m_vPos[j] = pos[j];
+					m_vVel[j] = 0.f;
+				}
+				ResetPositionCovariance(fStdDev*fStdDev);
+				return;
+			}
+
+			// h(x) = p, H = [I 0 0 0 0]
+			float H[3][k_iN] = {};
+			for (int j = 0; j < 3; j++)
+				H[j][k_iP + j] = 1.f;
+
+			float y[3] = {pos[0] - m_vPos[0], pos[1] - m_vPos[1], pos[2] - m_vPos[2]};
+			Update(H, y, fStdDev*fStdDev);
+		}
+
+		// pose at the last inertial sample as a streamed pose packet
+		void GetPosePacket(float* packet) const {
+			bool bHeld = m_fLastInertialTime - m_fLastOpticalTime > k_fImuOpticalTimeout;
+			float R[3][3];
+			QuatToMatrix(m_vRot, R);
+
+			float w[3] = {m_vGyro[0] - m_vBg[0], m_vGyro[1] - m_vBg[1], m_vGyro[2] - m_vBg[2]};
+
+			for (int j = 0; j < 3; j++) {
+				packet[j] = m_vPos[j];
+				packet[7 + j] = bHeld ? 0.f : m_vVel[j];
+				packet[10 + j] = R[j][0]*w[0] + R[j][1]*w[1] + R[j][2]*w[2]; // angular velocity is in driver space
+			}
+
+			packet[3] = m_vRot[0];
+			packet[4] = m_vRot[1];
+			packet[5] = m_vRot[2];
+			packet[6] = m_vRot[3];
+		}
+
+		double GetTime() const { return m_fLastInertialTime; }
+
+	private:
+		void Align(const float* gyro, const float* accel) {
+			for (int j = 0; j < 3; j++) {
+				m_vAlignGyro[j] += gyro[j];
+				m_vAlignAccel[j] += accel[j];
+			}
+
+			if (++m_unAlignCount < k_unImuAlignSamples)
+				return;
+
+			float inv = 1.f / (float)m_unAlignCount;
+			float f[3] = {m_vAlignAccel[0]*inv, m_vAlignAccel[1]*inv, m_vAlignAccel[2]*inv};
+			float fLen = std::sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+			if (!(fLen > 1e-3f)) {
+				Reset(); // no usable gravity reading, try again
+				return;
+			}
+
+			// shortest rotation taking the measured up (device frame) onto driver space up, yaw is arbitrary
+			// q = normalize(1 + u.w, u x w) with u = f/|f|, w = (0, 1, 0)
+			float u[3] = {f[0]/fLen, f[1]/fLen, f[2]/fLen};
+			float qw = 1.f + u[1], qx = -u[2], qy = 0.f, qz = u[0];
+			if (qw < 1e-4f) { // upside down, any horizontal axis works
+				qw = 0.f; qx = 1.f; qz = 0.f;
+			}
+			float qInv = 1.f / std::sqrt(qw*qw + qx*qx + qy*qy + qz*qz);
+			m_vRot[0] = qw*qInv; m_vRot[1] = qx*qInv; m_vRot[2] = qy*qInv; m_vRot[3] = qz*qInv;
+
+			for (int j = 0; j < 3; j++) {
+				m_vBg[j] = m_vAlignGyro[j]*inv;
+				m_vBa[j] = 0.f;
+				m_vVel[j] = 0.f;
+				if (!m_bHasPosition)
+					m_vPos[j] = 0.f;
+			}
+
+			memset(m_mP, 0, sizeof(m_mP));
+			for (int j = 0; j < 3; j++) {
+				m_mP[k_iP + j][k_iP + j] = 1.f;
+				m_mP[k_iV + j][k_iV + j] = 0.01f;
+				m_mP[k_iTheta + j][k_iTheta + j] = 0.01f;
+				m_mP[k_iBg + j][k_iBg + j] = 1e-4f;
+				m_mP[k_iBa + j][k_iBa + j] = 1e-2f;
+			}
+
+			m_bAligned = true;
+		}
+
+		void Propagate(const float* gyro, const float* accel, float dt) {
+			dt = std::min(dt, 0.05f);
+
+			float w[3] = {gyro[0] - m_vBg[0], gyro[1] - m_vBg[1], gyro[2] - m_vBg[2]};
+			float a[3] = {accel[0] - m_vBa[0], accel[1] - m_vBa[1], accel[2] - m_vBa[2]};
+
+			float R[3][3];
+			QuatToMatrix(m_vRot, R);
+
+			// nominal state
+			bool bHeld = m_fLastInertialTime - m_fLastOpticalTime > k_fImuOpticalTimeout;
+			if (bHeld) {
+				// double integrating the accelerometer without fixes runs away in seconds
+				m_vVel[0] = m_vVel[1] = m_vVel[2] = 0.f;
+				ResetPositionCovariance(1.f);
+			} else {
+				float aw[3];
+				for (int j = 0; j < 3; j++)
+					aw[j] = R[j][0]*a[0] + R[j][1]*a[1] + R[j][2]*a[2];
+				aw[1] -= k_fImuGravity;
+
+				for (int j = 0; j < 3; j++) {
+					m_vPos[j] += m_vVel[j]*dt + 0.5f*aw[j]*dt*dt;
+					m_vVel[j] += aw[j]*dt;
+				}
+			}
+
+			float dq[4];
+			RotationVectorToQuat(w[0]*dt, w[1]*dt, w[2]*dt, dq);
+			QuatMul(m_vRot, dq, m_vRot); // body rates, on the right
+			QuatNormalize(m_vRot);
+
+			// error state transition, first order
+			// dp' = dp + dv dt
+			// dv' = dv - R [a]x dtheta dt - R dba dt
+			// dtheta' = (I - [w dt]x) dtheta - dbg dt
+			float F[k_iN][k_iN] = {};
+			for (int j = 0; j < k_iN; j++)
+				F[j][j] = 1.f;
+
+			float Ra[3][3]; // R [a]x
+			float ax[3][3] = {{0.f, -a[2], a[1]}, {a[2], 0.f, -a[0]}, {-a[1], a[0], 0.f}};
+			for (int r = 0; r < 3; r++)
+				for (int c = 0; c < 3; c++)
+					Ra[r][c] = R[r][0]*ax[0][c] + R[r][1]*ax[1][c] + R[r][2]*ax[2][c];
+
+			for (int r = 0; r < 3; r++) {
+				F[k_iP + r][k_iV + r] = dt;
+				F[k_iTheta + r][k_iBg + r] = -dt;
+
+				for (int c = 0; c < 3; c++) {
+					F[k_iV + r][k_iTheta + c] = -Ra[r][c]*dt;
+					F[k_iV + r][k_iBa + c] = -R[r][c]*dt;
+				}
+			}
+
+			F[k_iTheta + 0][k_iTheta + 1] = w[2]*dt;
+			F[k_iTheta + 0][k_iTheta + 2] = -w[1]*dt;
+			F[k_iTheta + 1][k_iTheta + 0] = -w[2]*dt;
+			F[k_iTheta + 1][k_iTheta + 2] = w[0]*dt;
+			F[k_iTheta + 2][k_iTheta + 0] = w[1]*dt;
+			F[k_iTheta + 2][k_iTheta + 1] = -w[0]*dt;
+
+			// P = F P F^T + Q
+			float FP[k_iN][k_iN];
+			for (int r = 0; r < k_iN; r++) {
+				for (int c = 0; c < k_iN; c++) {
+					float sum = 0.f;
+					for (int k = 0; k < k_iN; k++)
+						sum += F[r][k]*m_mP[k][c];
+					FP[r][c] = sum;
+				}
+			}
+
+			for (int r = 0; r < k_iN; r++) {
+				for (int c = r; c < k_iN; c++) {
+					float sum = 0.f;
+					for (int k = 0; k < k_iN; k++)
+						sum += FP[r][k]*F[c][k];
+					m_mP[r][c] = m_mP[c][r] = sum;
+				}
+			}
+
+			float qV = m_Noise.fAccel*m_Noise.fAccel*dt;
+			float qTheta = m_Noise.fGyro*m_Noise.fGyro*dt;
+			float qBg = m_Noise.fGyroBiasWalk*m_Noise.fGyroBiasWalk*dt;
+			float qBa = m_Noise.fAccelBiasWalk*m_Noise.fAccelBiasWalk*dt;
+			for (int j = 0; j < 3; j++) {
+				m_mP[k_iV + j][k_iV + j] += qV;
+				m_mP[k_iTheta + j][k_iTheta + j] += qTheta;
+				m_mP[k_iBg + j][k_iBg + j] += qBg;
+				m_mP[k_iBa + j][k_iBa + j] += qBa;
+			}
+		}
+
+		// at rest the accelerometer reads R^T * (0, g, 0) + ba
+		// R_true = R (I + [dtheta]x), so d(R^T up)/d(dtheta) = [R^T up]x
+		void GravityUpdate(const float* accel) {
+			float aLen = std::sqrt(accel[0]*accel[0] + accel[1]*accel[1] + accel[2]*accel[2]);
+			if (std::fabs(aLen - k_fImuGravity) > k_fImuGravityGate)
+				return; // accelerating, the reading isn't gravity
+
+			float R[3][3];
+			QuatToMatrix(m_vRot, R);
+			float u[3] = {R[1][0]*k_fImuGravity, R[1][1]*k_fImuGravity, R[1][2]*k_fImuGravity}; // R^T (0, g, 0)
+
+			float H[3][k_iN] = {};
+			float ux[3][3] = {{0.f, -u[2], u[1]}, {u[2], 0.f, -u[0]}, {-u[1], u[0], 0.f}};
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 3; c++)
+					H[r][k_iTheta + c] = ux[r][c];
+				H[r][k_iBa + r] = 1.f;
+			}
+
+			float y[3];
+			for (int j = 0; j < 3; j++)
+				y[j] = accel[j] - (u[j] + m_vBa[j]);
+
+			Update(H, y, k_fImuGravityNoise*k_fImuGravityNoise);
+		}
+
+		// 3 dimensional measurement update, y is the innovation, fVariance the per axis measurement noise
+		void Update(const float H[3][k_iN], const float* y, float fVariance) {
+			// PHt = P H^T, S = H P H^T + R
+			float PHt[k_iN][3];
+			for (int r = 0; r < k_iN; r++) {
+				for (int c = 0; c < 3; c++) {
+					float sum = 0.f;
+					for (int k = 0; k < k_iN; k++)
+						sum += m_mP[r][k]*H[c][k];
+					PHt[r][c] = sum;
+				}
+			}
+
+			float S[3][3];
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 3; c++) {
+					float sum = 0.f;
+					for (int k = 0; k < k_iN; k++)
+						sum += H[r][k]*PHt[k][c];
+					S[r][c] = sum + (r == c ? fVariance : 0.f);
+				}
+			}
+
+			float Si[3][3];
+			if (!Invert3(S, Si))
+				return;
+
+			// K = P H^T S^-1, dx = K y
+			float K[k_iN][3];
+			float dx[k_iN];
+			for (int r = 0; r < k_iN; r++) {
+				for (int c = 0; c < 3; c++)
+					K[r][c] = PHt[r][0]*Si[0][c] + PHt[r][1]*Si[1][c] + PHt[r][2]*Si[2][c];
+				dx[r] = K[r][0]*y[0] + K[r][1]*y[1] + K[r][2]*y[2];
+			}
+
+			// P = P - K (H P), H P = PHt^T since P is symmetric
+			for (int r = 0; r < k_iN; r++) {
+				for (int c = r; c < k_iN; c++) {
+					float v = m_mP[r][c] - (K[r][0]*PHt[c][0] + K[r][1]*PHt[c][1] + K[r][2]*PHt[c][2]);
+					m_mP[r][c] = m_mP[c][r] = v;
+				}
+			}
+
+			// inject the error into the nominal state
+			for (int j = 0; j < 3; j++) {
+				m_vPos[j] += dx[k_iP + j];
+				m_vVel[j] += dx[k_iV + j];
+				m_vBg[j] += dx[k_iBg + j];
+				m_vBa[j] += dx[k_iBa + j];
+			}
+
+			float dq[4];
+			RotationVectorToQuat(dx[k_iTheta], dx[k_iTheta + 1], dx[k_iTheta + 2], dq);
+			QuatMul(m_vRot, dq, m_vRot);
+			QuatNormalize(m_vRot);
+		}
+
+		// position and velocity start over uncorrelated with the rest
+		void ResetPositionCovariance(float fPosVariance) {
+			for (int r = k_iP; r < k_iTheta; r++) {
+				for (int c = 0; c < k_iN; c++)
+					m_mP[r][c] = m_mP[c][r] = 0.f;
+			}
+
+			for (int j = 0; j < 3; j++) {
+				m_mP[k_iP + j][k_iP + j] = std::max(fPosVariance, 1e-6f);
+				m_mP[k_iV + j][k_iV + j] = 0.01f;
+			}
+		}
+
+		static bool Invert3(const float m[3][3], float out[3][3]) {
+			float c00 = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+			float c01 = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+			float c02 = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+			float det = m[0][0]*c00 + m[0][1]*c01 + m[0][2]*c02;
+			if (!(std::fabs(det) > 1e-20f))
+				return false;
+
+			float inv = 1.f / det;
+			out[0][0] = c00*inv;
+			out[1][0] = c01*inv;
+			out[2][0] = c02*inv;
+			out[0][1] = (m[0][2]*m[2][1] - m[0][1]*m[2][2])*inv;
+			out[1][1] = (m[0][0]*m[2][2] - m[0][2]*m[2][0])*inv;
+			out[2][1] = (m[0][1]*m[2][0] - m[0][0]*m[2][1])*inv;
+			out[0][2] = (m[0][1]*m[1][2] - m[0][2]*m[1][1])*inv;
+			out[1][2] = (m[0][2]*m[1][0] - m[0][0]*m[1][2])*inv;
+			out[2][2] = (m[0][0]*m[1][1] - m[0][1]*m[1][0])*inv;
+			return true;
+		}
+
+		// wxyz quaternions
+		static void QuatMul(const float* a, const float* b, float* out) {
+			float w = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+			float x = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+			float y = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+			float z = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+			out[0] = w; out[1] = x; out[2] = y; out[3] = z;
+		}
+
+		static void QuatNormalize(float* q) {
+			float inv = 1.f / std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+			for (int j = 0; j < 4; j++)
+				q[j] *= inv;
+		}
+
+		static void RotationVectorToQuat(float x, float y, float z, float* q) {
+			float angle = std::sqrt(x*x + y*y + z*z);
+			float k = angle > 1e-6f ? std::sin(0.5f*angle) / angle : 0.5f;
+			q[0] = std::cos(0.5f*angle);
+			q[1] = x*k;
+			q[2] = y*k;
+			q[3] = z*k;
+		}
+
+		static void QuatToMatrix(const float* q, float R[3][3]) {
+			float w = q[0], x = q[1], y = q[2], z = q[3];
+			R[0][0] = 1 - 2*(y*y + z*z); R[0][1] = 2*(x*y - w*z);     R[0][2] = 2*(x*z + w*y);
+			R[1][0] = 2*(x*y + w*z);     R[1][1] = 1 - 2*(x*x + z*z); R[1][2] = 2*(y*z - w*x);
+			R[2][0] = 2*(x*z - w*y);     R[2][1] = 2*(y*z + w*x);     R[2][2] = 1 - 2*(x*x + y*y);
+		}
+
+		HobovrImuNoise_t m_Noise = {0.005f, 0.05f, 1e-4f, 1e-3f, 0.005f};
+
+		float m_vPos[3] = {};
+		float m_vVel[3] = {};
+		float m_vRot[4] = {1.f, 0.f, 0.f, 0.f};
+		float m_vBg[3] = {};
+		float m_vBa[3] = {};
+		float m_vGyro[3] = {}; // last raw gyro sample, for the output angular velocity
+		float m_mP[k_iN][k_iN] = {};
+
+		uint32_t m_unAlignCount = 0;
+		float m_vAlignGyro[3] = {};
+		float m_vAlignAccel[3] = {};
+		bool m_bAligned = false;
+		bool m_bHasPosition = false;
+
+		double m_fLastInertialTime = 0.0;
+		double m_fLastOpticalTime = 0.0;
+		uint32_t m_unGravityCounter = 0;
+	};
+
+	// one filter per hot state slot, slots fed by imu frames take their pose from here instead of pose records
+	class HobovrImuFusion {
+	public:
+		void ResetSlot(uint32_t i) {
+			m_vFilters[i].Reset();
+		}
+
+		void SetNoise(const HobovrImuNoise_t& noise) {
+			m_fOpticalNoise = noise.fOptical;
+			for (auto& i : m_vFilters)
+				i.SetNoise(noise);
+		}
+
+		// slot i is fused and its pose records have to be ignored
+		bool IsActive(uint32_t i, double now) const {
+			return m_vFilters[i].IsActive(now);
+		}
+
+		// runs the samples of an imu frame through the filters and stores the result of every aligned filter that got
+		// inertial samples in s, arrivalTime is when the frame arrived, see GetSteadySeconds()
+		// every sample is fused but only the newest state per device is stored, so poses come out at the imu frame rate,
+		// posers wanting imu rate poses send every inertial sample in its own frame
+		void Process(const HobovrImuSample_t* samples, uint32_t sampleCount, uint32_t deviceCount, double arrivalTime, HobovrHotState_t& s) {
+			uint64_t touched = 0;
+
+			for (uint32_t k = 0; k < sampleCount; k++) {
+				const HobovrImuSample_t& sample = samples[k];
+				if (sample.device >= deviceCount)
+					continue;
+
+				double t = arrivalTime - ImuSampleAge(sample);
+				HobovrImuFilter& f = m_vFilters[sample.device];
+
+				if (sample.type == EHobovrImuSample_Inertial) {
+					if (!std::isfinite(sample.a[0] + sample.a[1] + sample.a[2] + sample.b[0] + sample.b[1] + sample.b[2]))
+						continue;
+
+					f.AddInertial(t, sample.a, sample.b);
+					touched |= 1ull << sample.device;
+
+				} else if (sample.type == EHobovrImuSample_Optical) {
+					if (!std::isfinite(sample.a[0] + sample.a[1] + sample.a[2]))
+						continue;
+
+					float fStdDev = sample.b[0] > 0.f && std::isfinite(sample.b[0]) ? sample.b[0] : m_fOpticalNoise;
+					f.AddOptical(t, sample.a, fStdDev);
+				}
+			}
+
+			for (uint32_t i = 0; i < deviceCount; i++) {
+				if (!((touched >> i) & 1) || !m_vFilters[i].IsAligned())
+					continue;
+
+				float packet[k_iPosePacketSize];
+				m_vFilters[i].GetPosePacket(packet);
+				HotStateStorePacket(s, i, packet, m_vFilters[i].GetTime(), true); // imu samples always carry their age
+			}
+		}
+
+	private:
+		HobovrImuFilter m_vFilters[k_unMaxHotStateDevices];
+		float m_fOpticalNoise = 0.005f;
+	};
+}
+
+#endif // HOBOVR_IMU_FUSION_H
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_INPUT_SCHEMA_H
+#define HOBOVR_INPUT_SCHEMA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hobovr_math.h"
+#include "hobovr_skeleton.h"
+
+namespace hobovr {
+	static const char *const k_pch_Controller_Section = "hobovr_device_controller";
+	static const char *const k_pch_Controller_InputSchema_String = "inputSchema";
+
+	// input schema, space separated entries of <type><packet offset>:<input path>
+	// types:
+	//   b - boolean, non zero is pressed
+	//   s - one sided scalar, [0, 1]
+	//   a - two sided scalar, [-1, 1]
+	//   k - hand skeleton, k_iSkeletonPacketSize floats of packed curls, see hobovr_skeleton.h
+	//       the path is the skeleton input without the side, "/left" or "/right" is appended, e.g. k22:/input/skeleton
+	// paths have to be inputs declared in the controller's input profile, see hobovr_controller_profile.json
+	// packet offsets index the device's float record, the pose takes the first k_iPosePacketSize floats
+	// input events address entries by order: button bit i is the i-th boolean entry, axis i the i-th scalar entry
+	static const char *const k_pch_Controller_DefaultInputSchema =
+		"b13:/input/grip/click "
+		"b14:/input/system/click "
+		"b15:/input/application_menu/click "
+		"b16:/input/trackpad/click "
+		"s17:/input/trigger/value "
+		"a18:/input/trackpad/x "
+		"a19:/input/trackpad/y "
+		"b20:/input/trackpad/touch "
+		"b21:/input/trigger/click";
+
+	enum EHobovrInputType {
+		EHobovrInput_Boolean = 'b',
+		EHobovrInput_ScalarOneSided = 's',
+		EHobovrInput_ScalarTwoSided = 'a',
+		EHobovrInput_Skeleton = 'k',
+	};
+
+	struct HobovrInputSchemaEntry_t {
+		EHobovrInputType type;
+		uint32_t offset; // float index in the device record
+		std::string path;
+	};
+
+	// parses a schema string, returns false if any entry is malformed
+	// malformed entries are logged and skipped, the rest is still returned
+	inline bool ParseInputSchema(const std::string& schema, std::vector<HobovrInputSchemaEntry_t>& entries) {
+		std::istringstream ss(schema);
+		std::string token;
+		bool bOk = true;
+
+		entries.clear();
+		while (ss >> token) {
+			size_t colon = token.find(':');
+			char* end = nullptr;
+			unsigned long offset = colon != std::string::npos && colon > 1 ? strtoul(token.c_str() + 1, &end, 10) : 0;
+			char type = token[0];
+
+			bool bValidType = type == EHobovrInput_Boolean || type == EHobovrInput_ScalarOneSided || type == EHobovrInput_ScalarTwoSided || type == EHobovrInput_Skeleton;
+			bool bValidOffset = end == token.c_str() + colon && offset >= (unsigned long)k_iPosePacketSize && offset < 4096;
+			bool bValidPath = colon != std::string::npos && colon + 1 < token.size() && token[colon + 1] == '/';
+
+			if (!bValidType || !bValidOffset || !bValidPath) {
+				DriverLog("input schema: bad entry '%s', skipped\n", token.c_str());
+				bOk = false;
+				continue;
+			}
+
+			entries.push_back({(EHobovrInputType)type, (uint32_t)offset, token.substr(colon + 1)});
+		}
+
+		return bOk && !entries.empty();
+	}
+
+	// compiled input schema, component handles and record offsets as flat per type tables
+	// Compile() creates the components once at activation, Update() is a straight loop per type
+	class HobovrInputTable {
+	public:
+		// creates an input component for every entry, entries that fail to be created are dropped
+		// only the first skeleton entry is used
+		void Compile(vr::PropertyContainerHandle_t ulContainer, const std::vector<HobovrInputSchemaEntry_t>& entries, bool bRightHand) {
+			m_vBooleans.clear();
+			m_vScalars.clear();
+			m_pSkeleton.reset();
+
+			for (auto& i : entries) {
+				vr::VRInputComponentHandle_t handle = vr::k_ulInvalidInputComponentHandle;
+				vr::EVRInputError err;
+
+				if (i.type == EHobovrInput_Skeleton) {
+					if (m_pSkeleton)
+						continue;
+
+					std::string side = bRightHand ? "right" : "left";
+					err = vr::VRDriverInput()->CreateSkeletonComponent(
+						ulContainer,
+						(i.path + "/" + side).c_str(),
+						("/skeleton/hand/" + side).c_str(),
+						"/pose/raw",
+						vr::VRSkeletalTracking_Partial,
+						nullptr,
+						0,
+						&handle
+					);
+
+					if (err == vr::VRInputError_None) {
+						m_pSkeleton = std::make_unique<HobovrHandSkeleton>(bRightHand);
+						m_Skeleton = {handle, i.offset};
+					}
+
+				} else if (i.type == EHobovrInput_Boolean) {
+					err = vr::VRDriverInput()->CreateBooleanComponent(ulContainer, i.path.c_str(), &handle);
+				} else {
+					err = vr::VRDriverInput()->CreateScalarComponent(
+						ulContainer,
+						i.path.c_str(),
+						&handle,
+						vr::VRScalarType_Absolute,
+						i.type == EHobovrInput_ScalarOneSided ? vr::VRScalarUnits_NormalizedOneSided : vr::VRScalarUnits_NormalizedTwoSided
+					);
+				}
+
+				if (err != vr::VRInputError_None) {
+					DriverLog("input schema: failed to create '%s', error %d\n", i.path.c_str(), (int)err);
+					continue;
+				}
+
+				if (i.type == EHobovrInput_Boolean)
+					m_vBooleans.push_back({handle, i.offset});
+				else if (i.type != EHobovrInput_Skeleton)
+					m_vScalars.push_back({handle, i.offset});
+			}
+
+			Bind(m_unRecordSize);
+		}
+
+		// restricts the per frame loops to entries that fit in records of unRecordSize floats
+		// has to be called with the device's udu record size, nothing is updated from records before that
+		void Bind(uint32_t unRecordSize) {
+			m_unRecordSize = unRecordSize;
+
+			auto fits = [unRecordSize](const Binding_t& b) { return b.offset < unRecordSize; };
+			m_vBooleansBound.clear();
+			m_vScalarsBound.clear();
+			std::copy_if(m_vBooleans.begin(), m_vBooleans.end(), std::back_inserter(m_vBooleansBound), fits);
+			std::copy_if(m_vScalars.begin(), m_vScalars.end(), std::back_inserter(m_vScalarsBound), fits);
+			m_bSkeletonBound = m_pSkeleton && m_Skeleton.offset + k_iSkeletonPacketSize <= unRecordSize;
+		}
+
+		// pushes every bound input from a device record
+		void Update(const float* record, double fTimeOffset) const {
+			auto ivrinput_cache = vr::VRDriverInput();
+
+			for (auto& i : m_vBooleansBound)
+				ivrinput_cache->UpdateBooleanComponent(i.handle, record[i.offset] != 0.f, fTimeOffset);
+
+			for (auto& i : m_vScalarsBound)
+				ivrinput_cache->UpdateScalarComponent(i.handle, record[i.offset], fTimeOffset);
+
+			if (m_bSkeletonBound) {
+				vr::VRBoneTransform_t bones[EHandBone_Count];
+				m_pSkeleton->Evaluate(record + m_Skeleton.offset, bones);
+
+				// curls come from the actual hand, so both ranges get the same pose
+				ivrinput_cache->UpdateSkeletonComponent(m_Skeleton.handle, vr::VRSkeletalMotionRange_WithController, bones, EHandBone_Count);
+				ivrinput_cache->UpdateSkeletonComponent(m_Skeleton.handle, vr::VRSkeletalMotionRange_WithoutController, bones, EHandBone_Count);
+			}
+		}
+
+		// input event helpers, i is the entry index within its type, in schema order
+		void UpdateBoolean(uint32_t i, bool bValue, double fTimeOffset) const {
+			if (i < m_vBooleans.size())
+				vr::VRDriverInput()->UpdateBooleanComponent(m_vBooleans[i].handle, bValue, fTimeOffset);
+		}
+
+		void UpdateScalar(uint32_t i, float fValue, double fTimeOffset) const {
+			if (i < m_vScalars.size())
+				vr::VRDriverInput()->UpdateScalarComponent(m_vScalars[i].handle, fValue, fTimeOffset);
+		}
+
+		uint32_t GetRecordSize() const { return m_unRecordSize; }
+		uint32_t GetBooleanCount() const { return (uint32_t)m_vBooleans.size(); }
+		uint32_t GetScalarCount() const { return (uint32_t)m_vScalars.size(); }
+
+	private:
+		struct Binding_t {
+			vr::VRInputComponentHandle_t handle;
+			uint32_t offset;
+		};
+
+		// every created component in schema order, input events index these
+		std::vector<Binding_t> m_vBooleans;
+		std::vector<Binding_t> m_vScalars;
+
+		// the ones that fit the device's record, the per frame loops run over these
+		std::vector<Binding_t> m_vBooleansBound;
+		std::vector<Binding_t> m_vScalarsBound;
+		uint32_t m_unRecordSize = 0;
+
+		std::unique_ptr<HobovrHandSkeleton> m_pSkeleton; // lut is big, only allocated if the schema has a skeleton
+		Binding_t m_Skeleton = {};
+		bool m_bSkeletonBound = false;
+	};
+}
+
+#endif // HOBOVR_INPUT_SCHEMA_H
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_MATH_H
+#define HOBOVR_MATH_H
+
+#include <cstring>
+
+// sse2 is always there on x64, on x86 only if the compiler was told so
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HOBOVR_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace hobovr {
+	// number of floats in a single streamed pose: pos(3) rot(4) vel(3) ang_vel(3)
+	static const int k_iPosePacketSize = 13;
+
+	// converts n floats into doubles, meant for short runs like pose vectors
+	inline void CvtFloatToDouble(double* dst, const float* src, int n) {
+		int i = 0;
+#ifdef HOBOVR_USE_SSE2
+		for (; i + 2 <= n; i += 2) {
+			__m128 f = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(src + i)));
+			_mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+		}
+#endif
+		for (; i < n; i++)
+			dst[i] = (double)src[i];
+	}
+
+	// writes the 13 streamed pose values into a driver pose, nothing else is touched
+	inline void PosePacketToDriverPose(vr::DriverPose_t& pose, const float* packet) {
+		CvtFloatToDouble(pose.vecPosition, packet, 3);
+		CvtFloatToDouble(&pose.qRotation.w, packet + 3, 4); // w, x, y, z are laid out back to back
+		CvtFloatToDouble(pose.vecVelocity, packet + 7, 3);
+		CvtFloatToDouble(pose.vecAngularVelocity, packet + 10, 3);
+	}
+}
+
+#endif // HOBOVR_MATH_H
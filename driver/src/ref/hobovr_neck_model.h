@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_NECK_MODEL_H
+#define HOBOVR_NECK_MODEL_H
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// hmd section keys, the eye depth is the hmd's UserHeadToEyeDepthMeters
+	static const char *const k_pch_Hmd_NeckModelEnable_Bool = "NeckModelEnable";
+	static const char *const k_pch_Hmd_NeckModelHeight_Float = "NeckModelHeight"; // m, neck pivot to eye level
+
+	struct HobovrNeckModelParams_t {
+		bool bEnable;
+		float fHeight; // m, up from the pivot
+		float fEyeDepth; // m, forward from the pivot
+	};
+
+	// derives the position of rotation only devices from their orientation
+	// the streamed position is taken as the neck pivot, the eyes sit up and forward of it in device space:
+	//   pos' = pos + R*n, vel' = vel + angVel x R*n, with n = (0, height, -eyeDepth)
+	// runs every frame after filtering so the derived position follows the rotation the user actually sees
+	class HobovrNeckModel {
+	public:
+		HobovrNeckModel() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				m_vParams[i] = {false, 0.f, 0.f};
+		}
+
+		void SetSlotParams(uint32_t i, const HobovrNeckModelParams_t& params) {
+			m_vParams[i] = params;
+		}
+
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated) || !m_vParams[i].bEnable)
+					continue;
+
+				float w = s.rotW[i], x = s.rotX[i], y = s.rotY[i], z = s.rotZ[i];
+				float h = m_vParams[i].fHeight, d = -m_vParams[i].fEyeDepth;
+
+				// R*(0, h, d), only the last two columns of R are needed
+				float rx = 2*(x*y - w*z)*h + 2*(x*z + w*y)*d;
+				float ry = (1 - 2*(x*x + z*z))*h + 2*(y*z - w*x)*d;
+				float rz = 2*(y*z + w*x)*h + (1 - 2*(x*x + y*y))*d;
+
+				s.posX[i] += rx;
+				s.posY[i] += ry;
+				s.posZ[i] += rz;
+
+				s.velX[i] += s.angVelY[i]*rz - s.angVelZ[i]*ry;
+				s.velY[i] += s.angVelZ[i]*rx - s.angVelX[i]*rz;
+				s.velZ[i] += s.angVelX[i]*ry - s.angVelY[i]*rx;
+			}
+		}
+
+	private:
+		HobovrNeckModelParams_t m_vParams[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_NECK_MODEL_H
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_ONE_EURO_H
+#define HOBOVR_ONE_EURO_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class keys, read from the class's own section
+	static const char *const k_pch_Filter_Enable_Bool = "FilterEnable";
+	static const char *const k_pch_Filter_PositionMinCutoff_Float = "FilterPositionMinCutoff";
+	static const char *const k_pch_Filter_PositionBeta_Float = "FilterPositionBeta";
+	static const char *const k_pch_Filter_RotationMinCutoff_Float = "FilterRotationMinCutoff";
+	static const char *const k_pch_Filter_RotationBeta_Float = "FilterRotationBeta";
+
+	// cutoff of the speed estimate that drives the adaptive cutoff, Hz
+	static const float k_fOneEuroDerivativeCutoff = 1.f;
+
+	// samples further apart than this restart the filter instead of smoothing across the gap
+	static const double k_fOneEuroMaxInterval = 0.25;
+
+	struct HobovrFilterParams_t {
+		bool bEnable;
+		float fPosMinCutoff; // Hz, cutoff at rest
+		float fPosBeta; // Hz per m/s, how fast the cutoff opens up with speed
+		float fRotMinCutoff; // Hz
+		float fRotBeta; // Hz per rad/s
+	};
+
+	// One Euro filter over the pose of every updated hot state slot
+	// low cutoff while still to kill jitter, cutoff rising with speed to keep lag down when moving
+	// position is filtered per axis with a cutoff from the speed magnitude,
+	// rotation is a nlerp toward the new sample with a cutoff from the angular speed
+	// state is fixed size per slot, no allocations, constant time per slot
+	class HobovrOneEuroFilter {
+	public:
+		HobovrOneEuroFilter() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vParams[i] = {false, 1.f, 0.f, 1.f, 0.f};
+				ResetSlot(i);
+			}
+		}
+
+		void SetSlotParams(uint32_t i, const HobovrFilterParams_t& params) {
+			if (params.bEnable && !m_vParams[i].bEnable)
+				ResetSlot(i); // don't smooth from a pose that is seconds old
+
+			m_vParams[i] = params;
+		}
+
+		// forget the history of slot i, the next sample passes through unfiltered
+		void ResetSlot(uint32_t i) {
+			m_vSlot[i] = {};
+		}
+
+		// filters updated slots in [begin, end) in place
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated) || !m_vParams[i].bEnable)
+					continue;
+
+				FilterSlot(s, i);
+			}
+		}
+
+	private:
+		struct Slot_t {
+			float pos[3]; // last filtered position
+			float rot[4]; // last filtered rotation, wxyz
+			float posSpeed; // filtered speed, m/s
+			float rotSpeed; // filtered angular speed, rad/s
+			double time; // sample time of the last filtered pose, 0 if there is none
+		};
+
+		// smoothing factor of a first order low pass at fCutoff for a step of dt
+		static float Alpha(float fCutoff, float dt) {
+			float tau = 1.f / (6.28318531f * std::max(fCutoff, 1e-3f)); // 1/(2*pi*fc)
+			return 1.f / (1.f + tau / dt);
+		}
+
+		void FilterSlot(HobovrHotState_t& s, uint32_t i) {
+			const HobovrFilterParams_t& p = m_vParams[i];
+			Slot_t& f = m_vSlot[i];
+			double dtFull = s.sampleTime[i] - f.time;
+
+			if (f.time <= 0.0 || dtFull <= 1e-5 || dtFull > k_fOneEuroMaxInterval) {
+				f.pos[0] = s.posX[i];
+				f.pos[1] = s.posY[i];
+				f.pos[2] = s.posZ[i];
+				f.rot[0] = s.rotW[i];
+				f.rot[1] = s.rotX[i];
+				f.rot[2] = s.rotY[i];
+				f.rot[3] = s.rotZ[i];
+				f.posSpeed = f.rotSpeed = 0.f;
+				f.time = s.sampleTime[i];
+				return;
+			}
+
+			float dt = (float)dtFull;
+			float aDeriv = Alpha(k_fOneEuroDerivativeCutoff, dt);
+
+			// position
+			float dx = s.posX[i] - f.pos[0];
+			float dy = s.posY[i] - f.pos[1];
+			float dz = s.posZ[i] - f.pos[2];
+			float speed = std::sqrt(dx*dx + dy*dy + dz*dz) / dt;
+			f.posSpeed += (speed - f.posSpeed) * aDeriv;
+
+			float aPos = Alpha(p.fPosMinCutoff + p.fPosBeta*f.posSpeed, dt);
+			f.pos[0] += dx * aPos;
+			f.pos[1] += dy * aPos;
+			f.pos[2] += dz * aPos;
+
+			// rotation, take the short way around
+			float qw = s.rotW[i], qx = s.rotX[i], qy = s.rotY[i], qz = s.rotZ[i];
+			float dot = f.rot[0]*qw + f.rot[1]*qx + f.rot[2]*qy + f.rot[3]*qz;
+			if (dot < 0.f) {
+				qw = -qw; qx = -qx; qy = -qy; qz = -qz;
+				dot = -dot;
+			}
+
+			float angSpeed = 2.f * std::acos(std::min(dot, 1.f)) / dt;
+			f.rotSpeed += (angSpeed - f.rotSpeed) * aDeriv;
+
+			float aRot = Alpha(p.fRotMinCutoff + p.fRotBeta*f.rotSpeed, dt);
+			float rw = f.rot[0] + (qw - f.rot[0]) * aRot;
+			float rx = f.rot[1] + (qx - f.rot[1]) * aRot;
+			float ry = f.rot[2] + (qy - f.rot[2]) * aRot;
+			float rz = f.rot[3] + (qz - f.rot[3]) * aRot;
+			float invLen = 1.f / std::sqrt(rw*rw + rx*rx + ry*ry + rz*rz); // validated unit inputs on the same hemisphere, never near 0
+
+			f.rot[0] = rw * invLen;
+			f.rot[1] = rx * invLen;
+			f.rot[2] = ry * invLen;
+			f.rot[3] = rz * invLen;
+			f.time = s.sampleTime[i];
+
+			s.posX[i] = f.pos[0];
+			s.posY[i] = f.pos[1];
+			s.posZ[i] = f.pos[2];
+			s.rotW[i] = f.rot[0];
+			s.rotX[i] = f.rot[1];
+			s.rotY[i] = f.rot[2];
+			s.rotZ[i] = f.rot[3];
+		}
+
+		HobovrFilterParams_t m_vParams[k_unMaxHotStateDevices];
+		Slot_t m_vSlot[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_ONE_EURO_H
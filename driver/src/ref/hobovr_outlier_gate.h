@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_OUTLIER_GATE_H
+#define HOBOVR_OUTLIER_GATE_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class keys, read from the class's own section
+	static const char *const k_pch_Outlier_Enable_Bool = "OutlierGateEnable";
+	static const char *const k_pch_Outlier_PositionTolerance_Float = "OutlierPositionTolerance"; // m, measurement noise allowance
+	static const char *const k_pch_Outlier_MaxAcceleration_Float = "OutlierMaxAcceleration"; // m/s^2
+	static const char *const k_pch_Outlier_AcceptCount_Int32 = "OutlierAcceptCount"; // consistent samples before a jump is believed
+
+	// rejected samples are extrapolated from the last good one for this long, then it is held
+	static const float k_fOutlierMaxExtrapolation = 0.1f;
+
+	// samples this far apart are accepted as is, the device may have gone anywhere in between
+	static const double k_fOutlierMaxGap = 0.5;
+
+	struct HobovrOutlierParams_t {
+		bool bEnable;
+		float fPosTolerance;
+		float fMaxAcceleration;
+		int iAcceptCount;
+	};
+
+	// rejects samples that can't physically follow the last good one
+	// a sample passes if it is within tolerance + max acceleration of where the last good sample's velocity puts it,
+	// and neither its speed nor its rotation rate from the last good sample is over the validator's limits
+	// rejected samples are replaced by the extrapolated last good pose
+	// rejected samples that agree with each other for iAcceptCount samples in a row are taken as a real jump
+	// constant time per slot, run after the validator so every input is finite
+	class HobovrOutlierGate {
+	public:
+		HobovrOutlierGate() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vParams[i] = {false, 0.05f, 100.f, 3};
+				ResetSlot(i);
+			}
+		}
+
+		void SetLimits(float fMaxLinearVelocity, float fMaxAngularVelocity) {
+			m_fMaxLinVel = fMaxLinearVelocity;
+			m_fMaxAngVel = fMaxAngularVelocity;
+		}
+
+		void SetSlotParams(uint32_t i, const HobovrOutlierParams_t& params) {
+			if (params.bEnable && !m_vParams[i].bEnable)
+				ResetSlot(i);
+
+			m_vParams[i] = params;
+		}
+
+		void ResetSlot(uint32_t i) {
+			m_vSlot[i] = {};
+		}
+
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated) || !m_vParams[i].bEnable)
+					continue;
+
+				GateSlot(s, i);
+			}
+		}
+
+	private:
+		struct Slot_t {
+			float pos[3]; // last good sample
+			float rot[4];
+			float vel[3]; // streamed velocity of the last good sample, or its finite difference if none was streamed
+			double time; // 0 if there is no good sample
+
+			float candPos[3]; // last rejected sample, a possible new location
+			float candVel[3];
+			double candTime;
+			int candCount; // rejected samples in a row that agree with each other
+		};
+
+		void GateSlot(HobovrHotState_t& s, uint32_t i) {
+			const HobovrOutlierParams_t& p = m_vParams[i];
+			Slot_t& g = m_vSlot[i];
+			double t = s.sampleTime[i];
+			double dtFull = t - g.time;
+
+			if (g.time <= 0.0 || dtFull > k_fOutlierMaxGap) {
+				Accept(s, i, 0.f);
+				return;
+			}
+
+			float dt = (float)std::max(dtFull, 1e-4);
+			float limit = p.fPosTolerance + 0.5f*p.fMaxAcceleration*dt*dt;
+
+			float dx = s.posX[i] - g.pos[0];
+			float dy = s.posY[i] - g.pos[1];
+			float dz = s.posZ[i] - g.pos[2];
+			float ex = dx - g.vel[0]*dt;
+			float ey = dy - g.vel[1]*dt;
+			float ez = dz - g.vel[2]*dt;
+
+			bool bPosOk = ex*ex + ey*ey + ez*ez <= limit*limit;
+			bool bSpeedOk = dx*dx + dy*dy + dz*dz <= (p.fPosTolerance + m_fMaxLinVel*dt)*(p.fPosTolerance + m_fMaxLinVel*dt);
+
+			float dot = std::fabs(g.rot[0]*s.rotW[i] + g.rot[1]*s.rotX[i] + g.rot[2]*s.rotY[i] + g.rot[3]*s.rotZ[i]);
+			bool bRotOk = 2.f*std::acos(std::min(dot, 1.f)) <= m_fMaxAngVel*dt;
+
+			if (bPosOk && bSpeedOk && bRotOk) {
+				g.candCount = 0;
+				Accept(s, i, dt);
+				return;
+			}
+
+			// a new location has to hold still or move plausibly for a few samples before it is believed
+			float cdt = (float)std::max(t - g.candTime, 1e-4);
+			float cLimit = p.fPosTolerance + 0.5f*p.fMaxAcceleration*cdt*cdt;
+			float cx = s.posX[i] - g.candPos[0];
+			float cy = s.posY[i] - g.candPos[1];
+			float cz = s.posZ[i] - g.candPos[2];
+			float cex = cx - g.candVel[0]*cdt;
+			float cey = cy - g.candVel[1]*cdt;
+			float cez = cz - g.candVel[2]*cdt;
+			bool bConsistent = g.candCount > 0 && cex*cex + cey*cey + cez*cez <= cLimit*cLimit;
+
+			if (bConsistent) {
+				g.candVel[0] = cx / cdt;
+				g.candVel[1] = cy / cdt;
+				g.candVel[2] = cz / cdt;
+				g.candCount++;
+			} else {
+				g.candVel[0] = g.candVel[1] = g.candVel[2] = 0.f;
+				g.candCount = 1;
+			}
+
+			g.candPos[0] = s.posX[i];
+			g.candPos[1] = s.posY[i];
+			g.candPos[2] = s.posZ[i];
+			g.candTime = t;
+
+			if (g.candCount >= std::max(p.iAcceptCount, 1)) {
+				s.stats[i].outliersReacquired++;
+				g.candCount = 0;
+				Accept(s, i, 0.f);
+				return;
+			}
+
+			s.stats[i].outliersRejected++;
+
+			// extrapolate the last good pose, hold it once that gets too speculative
+			float h = (float)std::min(dtFull, (double)k_fOutlierMaxExtrapolation);
+			bool bHold = dtFull > k_fOutlierMaxExtrapolation;
+			s.posX[i] = g.pos[0] + g.vel[0]*h;
+			s.posY[i] = g.pos[1] + g.vel[1]*h;
+			s.posZ[i] = g.pos[2] + g.vel[2]*h;
+			s.rotW[i] = g.rot[0];
+			s.rotX[i] = g.rot[1];
+			s.rotY[i] = g.rot[2];
+			s.rotZ[i] = g.rot[3];
+			s.velX[i] = bHold ? 0.f : g.vel[0];
+			s.velY[i] = bHold ? 0.f : g.vel[1];
+			s.velZ[i] = bHold ? 0.f : g.vel[2];
+			s.angVelX[i] = s.angVelY[i] = s.angVelZ[i] = 0.f;
+		}
+
+		// slot i's sample becomes the last good one, dt is the time since the previous good one or 0 if there is none
+		void Accept(const HobovrHotState_t& s, uint32_t i, float dt) {
+			Slot_t& g = m_vSlot[i];
+			bool bStreamedVel = s.velX[i] != 0.f || s.velY[i] != 0.f || s.velZ[i] != 0.f;
+
+			if (bStreamedVel) {
+				g.vel[0] = s.velX[i];
+				g.vel[1] = s.velY[i];
+				g.vel[2] = s.velZ[i];
+			} else if (dt > 0.f) {
+				g.vel[0] = (s.posX[i] - g.pos[0]) / dt;
+				g.vel[1] = (s.posY[i] - g.pos[1]) / dt;
+				g.vel[2] = (s.posZ[i] - g.pos[2]) / dt;
+			} else {
+				g.vel[0] = g.vel[1] = g.vel[2] = 0.f;
+			}
+
+			g.pos[0] = s.posX[i];
+			g.pos[1] = s.posY[i];
+			g.pos[2] = s.posZ[i];
+			g.rot[0] = s.rotW[i];
+			g.rot[1] = s.rotX[i];
+			g.rot[2] = s.rotY[i];
+			g.rot[3] = s.rotZ[i];
+			g.time = s.sampleTime[i];
+		}
+
+		float m_fMaxLinVel = 20.f; // m/s
+		float m_fMaxAngVel = 60.f; // rad/s
+
+		HobovrOutlierParams_t m_vParams[k_unMaxHotStateDevices];
+		Slot_t m_vSlot[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_OUTLIER_GATE_H
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_POSE_PIPELINE_H
+#define HOBOVR_POSE_PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class key, read from the class's own section
+	// space separated stage names in the order they run, e.g. "outlier velocity filter predict"
+	static const char *const k_pch_Pipeline_Stages_String = "PoseStages";
+	static const char *const k_pch_Pipeline_DefaultStages = "outlier velocity filter neck predict";
+	// driver wide, times every stage, read back through the tracking reference's "stats" debug request
+	static const char *const k_pch_Hobovr_PoseStageTimers_Bool = "PoseStageTimers";
+
+	enum EHobovrPoseStage {
+		// fixed head, every slot goes through these first, they make every pose finite and put it in world space
+		EPoseStage_Validate = 0,
+		EPoseStage_Calibrate,
+
+		// configurable per device class
+		EPoseStage_Outlier,
+		EPoseStage_Velocity,
+		EPoseStage_Filter,
+		EPoseStage_Neck,
+		EPoseStage_Predict,
+
+		EPoseStage_Count
+	};
+
+	static const char *const k_pchPoseStageNames[EPoseStage_Count] = {
+		"validate",
+		"calibrate",
+		"outlier",
+		"velocity",
+		"filter",
+		"neck",
+		"predict",
+	};
+
+	static const uint32_t k_unPipelineClasses = 3; // EHobovrDeviceNodeTypes
+
+	struct HobovrPipelineConfig_t {
+		uint8_t stages[EPoseStage_Count]; // EHobovrPoseStage, in order
+		uint32_t count;
+	};
+
+	// only configurable stages, each at most once
+	inline bool ParsePoseStages(const std::string& text, HobovrPipelineConfig_t& out) {
+		std::istringstream ss(text);
+		std::string token;
+		HobovrPipelineConfig_t c = {};
+		uint32_t seen = 0;
+
+		while (ss >> token) {
+			int stage = -1;
+			for (int i = EPoseStage_Outlier; i < EPoseStage_Count; i++) {
+				if (token == k_pchPoseStageNames[i])
+					stage = i;
+			}
+
+			if (stage < 0 || (seen & (1u << stage)))
+				return false;
+
+			seen |= 1u << stage;
+			c.stages[c.count++] = (uint8_t)stage;
+		}
+
+		out = c;
+		return true;
+	}
+
+	inline std::string FormatPoseStages(const HobovrPipelineConfig_t& c) {
+		std::string ret;
+		for (uint32_t i = 0; i < c.count; i++) {
+			if (i)
+				ret += ' ';
+			ret += k_pchPoseStageNames[c.stages[i]];
+		}
+		return ret;
+	}
+
+	// runs the pose stages over a range of slots, in the order configured for each slot's device class
+	// the stages themselves stay with the driver, Run() hands (stage, begin, end) to a callable that switches on the stage,
+	// so dispatch is a switch the compiler can see through and not a virtual call per sample
+	// slots of one class are run together in runs of consecutive slots, the head stages run over the whole range at once
+	// stages are only timed while timers are on, the counters are atomic so ranges can run on several threads
+	// the stage lists and the timer switch are only set between frames, never while a range runs
+	class HobovrPosePipeline {
+	public:
+		HobovrPosePipeline() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				m_vSlotClass[i] = 0;
+
+			HobovrPipelineConfig_t config;
+			ParsePoseStages(k_pch_Pipeline_DefaultStages, config);
+			for (uint32_t i = 0; i < k_unPipelineClasses; i++)
+				m_vClassStages[i] = config;
+
+			ResetTimers();
+		}
+
+		void SetSlotClass(uint32_t i, uint32_t unClass) {
+			m_vSlotClass[i] = (uint8_t)std::min(unClass, k_unPipelineClasses - 1);
+		}
+
+		void SetClassStages(uint32_t unClass, const HobovrPipelineConfig_t& config) {
+			m_vClassStages[unClass] = config;
+		}
+
+		const HobovrPipelineConfig_t& GetClassStages(uint32_t unClass) const {
+			return m_vClassStages[unClass];
+		}
+
+		// off by default, two clock reads per stage per range add up with many devices
+		void SetTimers(bool bEnable) {
+			if (bEnable != m_bTimers)
+				ResetTimers();
+
+			m_bTimers = bEnable;
+		}
+
+		// runStage(EHobovrPoseStage, begin, end), begin is a multiple of 4 for the head stages
+		template <typename F>
+		void Run(uint32_t begin, uint32_t end, const F& runStage) {
+			if (m_bTimers)
+				RunStages<true>(begin, end, runStage);
+			else
+				RunStages<false>(begin, end, runStage);
+		}
+
+		void ResetTimers() {
+			for (int i = 0; i < EPoseStage_Count; i++) {
+				m_vStageNs[i].store(0, std::memory_order_relaxed);
+				m_vStageSlots[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		// "stage avg ns/slot (total ms)" for every stage that ran since the last reset, then resets
+		int FormatTimers(char* buff, uint32_t size) {
+			int len = 0;
+			buff[0] = 0;
+
+			for (int i = 0; i < EPoseStage_Count && len >= 0 && (uint32_t)len < size; i++) {
+				uint64_t ns = m_vStageNs[i].exchange(0, std::memory_order_relaxed);
+				uint64_t slots = m_vStageSlots[i].exchange(0, std::memory_order_relaxed);
+				if (!slots)
+					continue;
+
+				len += snprintf(buff + len, size - len, "%s%s %.0f ns/slot (%.2f ms)",
+					len ? ", " : "",
+					k_pchPoseStageNames[i],
+					(double)ns / (double)slots,
+					(double)ns * 1e-6
+				);
+			}
+
+			return len;
+		}
+
+	private:
+		template <bool Timed, typename F>
+		void RunStages(uint32_t begin, uint32_t end, const F& runStage) {
+			RunStage<Timed>(EPoseStage_Validate, begin, end, runStage);
+			RunStage<Timed>(EPoseStage_Calibrate, begin, end, runStage);
+
+			uint32_t runBegin = begin;
+			while (runBegin < end) {
+				uint32_t cls = m_vSlotClass[runBegin];
+				uint32_t runEnd = runBegin + 1;
+				while (runEnd < end && m_vSlotClass[runEnd] == cls)
+					runEnd++;
+
+				const HobovrPipelineConfig_t& config = m_vClassStages[cls];
+				for (uint32_t k = 0; k < config.count; k++)
+					RunStage<Timed>((EHobovrPoseStage)config.stages[k], runBegin, runEnd, runStage);
+
+				runBegin = runEnd;
+			}
+		}
+
+		template <bool Timed, typename F>
+		void RunStage(EHobovrPoseStage stage, uint32_t begin, uint32_t end, const F& runStage) {
+			if (!Timed) {
+				runStage(stage, begin, end);
+				return;
+			}
+
+			auto t0 = std::chrono::steady_clock::now();
+			runStage(stage, begin, end);
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+
+			m_vStageNs[stage].fetch_add((uint64_t)ns, std::memory_order_relaxed);
+			m_vStageSlots[stage].fetch_add(end - begin, std::memory_order_relaxed);
+		}
+
+		uint8_t m_vSlotClass[k_unMaxHotStateDevices];
+		HobovrPipelineConfig_t m_vClassStages[k_unPipelineClasses];
+		bool m_bTimers = false;
+
+		std::atomic<uint64_t> m_vStageNs[EPoseStage_Count];
+		std::atomic<uint64_t> m_vStageSlots[EPoseStage_Count];
+	};
+}
+
+#endif // HOBOVR_POSE_PIPELINE_H
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_POSE_VALIDATION_H
+#define HOBOVR_POSE_VALIDATION_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	static const char *const k_pch_Hobovr_MaxLinearVelocity_Float = "MaxLinearVelocity";
+	static const char *const k_pch_Hobovr_MaxAngularVelocity_Float = "MaxAngularVelocity";
+
+	// validates and fixes up the fresh samples of updated hot state slots before anything else touches them
+	// slots without a new sample hold last frame's pipeline output, that is neither checked nor remembered
+	// - quaternions get renormalized
+	// - NaN/Inf positions and zero/NaN/Inf quaternions fall back to the last good pose
+	// - NaN/Inf velocities get zeroed, absurd ones get clamped to the configured max
+	// runs 4 slots at a time with sse2, slots are independent so any range of slots can be validated
+	class HobovrPoseValidator {
+	public:
+		HobovrPoseValidator() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				ResetSlot(i);
+		}
+
+		void SetLimits(float fMaxLinearVelocity, float fMaxAngularVelocity) {
+			m_fMaxLinVel = fMaxLinearVelocity;
+			m_fMaxAngVel = fMaxAngularVelocity;
+		}
+
+		// forget the last good pose of slot i, use when the slot gets a new device
+		void ResetSlot(uint32_t i) {
+			m_vLastPosX[i] = m_vLastPosY[i] = m_vLastPosZ[i] = 0.f;
+			m_vLastRotW[i] = 1.f;
+			m_vLastRotX[i] = m_vLastRotY[i] = m_vLastRotZ[i] = 0.f;
+		}
+
+		// validates slots [begin, end), begin has to be a multiple of 4
+		// the range gets rounded up to a multiple of 4, unused slots are kept as identity so that is fine
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			end = std::min((end + 3u) & ~3u, k_unMaxHotStateDevices);
+
+#ifdef HOBOVR_USE_SSE2
+			for (uint32_t i = begin; i < end; i += 4)
+				RunGroup(s, i);
+#else
+			for (uint32_t i = begin; i < end; i++)
+				RunSlot(s, i);
+#endif
+		}
+
+	private:
+#ifdef HOBOVR_USE_SSE2
+		static inline __m128 IsFinite(__m128 x) {
+			return _mm_cmpeq_ps(_mm_sub_ps(x, x), _mm_setzero_ps()); // x - x is NaN for NaN and Inf
+		}
+
+		static inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		static inline void ClampVec3(__m128& x, __m128& y, __m128& z, float fMax, int& iClamped) {
+			__m128 finite = _mm_and_ps(_mm_and_ps(IsFinite(x), IsFinite(y)), IsFinite(z));
+			x = _mm_and_ps(finite, x);
+			y = _mm_and_ps(finite, y);
+			z = _mm_and_ps(finite, z);
+
+			__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+			__m128 max = _mm_set1_ps(fMax);
+			__m128 tooFast = _mm_cmpgt_ps(len2, _mm_mul_ps(max, max));
+			__m128 scale = Select(tooFast, _mm_div_ps(max, _mm_sqrt_ps(len2)), _mm_set1_ps(1.f));
+			x = _mm_mul_ps(x, scale);
+			y = _mm_mul_ps(y, scale);
+			z = _mm_mul_ps(z, scale);
+
+			iClamped = _mm_movemask_ps(_mm_or_ps(_mm_andnot_ps(finite, _mm_castsi128_ps(_mm_set1_epi32(-1))), tooFast));
+		}
+
+		void RunGroup(HobovrHotState_t& s, uint32_t i) {
+			__m128i updatedBit = _mm_set1_epi32((int)EHotState_Updated);
+			__m128 updated = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_load_si128((const __m128i*)(s.flags + i)), updatedBit), updatedBit));
+			int iUpdated = _mm_movemask_ps(updated);
+			if (!iUpdated)
+				return;
+
+			__m128 px = _mm_load_ps(s.posX + i);
+			__m128 py = _mm_load_ps(s.posY + i);
+			__m128 pz = _mm_load_ps(s.posZ + i);
+			__m128 qw = _mm_load_ps(s.rotW + i);
+			__m128 qx = _mm_load_ps(s.rotX + i);
+			__m128 qy = _mm_load_ps(s.rotY + i);
+			__m128 qz = _mm_load_ps(s.rotZ + i);
+
+			__m128 posOk = _mm_and_ps(_mm_and_ps(IsFinite(px), IsFinite(py)), IsFinite(pz));
+
+			__m128 n2 = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(qw, qw), _mm_mul_ps(qx, qx)),
+				_mm_add_ps(_mm_mul_ps(qy, qy), _mm_mul_ps(qz, qz))
+			);
+			__m128 quatOk = _mm_and_ps(IsFinite(n2), _mm_cmpgt_ps(n2, _mm_set1_ps(k_fMinQuatNorm2)));
+			__m128 absDev = _mm_andnot_ps(_mm_set1_ps(-0.f), _mm_sub_ps(n2, _mm_set1_ps(1.f)));
+			__m128 nonUnit = _mm_and_ps(quatOk, _mm_cmpgt_ps(absDev, _mm_set1_ps(k_fUnitQuatTolerance)));
+
+			__m128 invLen = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(Select(quatOk, n2, _mm_set1_ps(1.f))));
+			qw = _mm_mul_ps(qw, invLen);
+			qx = _mm_mul_ps(qx, invLen);
+			qy = _mm_mul_ps(qy, invLen);
+			qz = _mm_mul_ps(qz, invLen);
+
+			__m128 good = _mm_and_ps(posOk, quatOk);
+			px = Select(good, px, _mm_load_ps(m_vLastPosX + i));
+			py = Select(good, py, _mm_load_ps(m_vLastPosY + i));
+			pz = Select(good, pz, _mm_load_ps(m_vLastPosZ + i));
+			qw = Select(good, qw, _mm_load_ps(m_vLastRotW + i));
+			qx = Select(good, qx, _mm_load_ps(m_vLastRotX + i));
+			qy = Select(good, qy, _mm_load_ps(m_vLastRotY + i));
+			qz = Select(good, qz, _mm_load_ps(m_vLastRotZ + i));
+
+			_mm_store_ps(s.posX + i, Select(updated, px, _mm_load_ps(s.posX + i)));
+			_mm_store_ps(s.posY + i, Select(updated, py, _mm_load_ps(s.posY + i)));
+			_mm_store_ps(s.posZ + i, Select(updated, pz, _mm_load_ps(s.posZ + i)));
+			_mm_store_ps(s.rotW + i, Select(updated, qw, _mm_load_ps(s.rotW + i)));
+			_mm_store_ps(s.rotX + i, Select(updated, qx, _mm_load_ps(s.rotX + i)));
+			_mm_store_ps(s.rotY + i, Select(updated, qy, _mm_load_ps(s.rotY + i)));
+			_mm_store_ps(s.rotZ + i, Select(updated, qz, _mm_load_ps(s.rotZ + i)));
+
+			_mm_store_ps(m_vLastPosX + i, Select(updated, px, _mm_load_ps(m_vLastPosX + i)));
+			_mm_store_ps(m_vLastPosY + i, Select(updated, py, _mm_load_ps(m_vLastPosY + i)));
+			_mm_store_ps(m_vLastPosZ + i, Select(updated, pz, _mm_load_ps(m_vLastPosZ + i)));
+			_mm_store_ps(m_vLastRotW + i, Select(updated, qw, _mm_load_ps(m_vLastRotW + i)));
+			_mm_store_ps(m_vLastRotX + i, Select(updated, qx, _mm_load_ps(m_vLastRotX + i)));
+			_mm_store_ps(m_vLastRotY + i, Select(updated, qy, _mm_load_ps(m_vLastRotY + i)));
+			_mm_store_ps(m_vLastRotZ + i, Select(updated, qz, _mm_load_ps(m_vLastRotZ + i)));
+
+			// velocities of rejected poses are meaningless
+			__m128 vx = _mm_and_ps(good, _mm_load_ps(s.velX + i));
+			__m128 vy = _mm_and_ps(good, _mm_load_ps(s.velY + i));
+			__m128 vz = _mm_and_ps(good, _mm_load_ps(s.velZ + i));
+			__m128 wx = _mm_and_ps(good, _mm_load_ps(s.angVelX + i));
+			__m128 wy = _mm_and_ps(good, _mm_load_ps(s.angVelY + i));
+			__m128 wz = _mm_and_ps(good, _mm_load_ps(s.angVelZ + i));
+
+			int iLinClamped, iAngClamped;
+			ClampVec3(vx, vy, vz, m_fMaxLinVel, iLinClamped);
+			ClampVec3(wx, wy, wz, m_fMaxAngVel, iAngClamped);
+
+			_mm_store_ps(s.velX + i, Select(updated, vx, _mm_load_ps(s.velX + i)));
+			_mm_store_ps(s.velY + i, Select(updated, vy, _mm_load_ps(s.velY + i)));
+			_mm_store_ps(s.velZ + i, Select(updated, vz, _mm_load_ps(s.velZ + i)));
+			_mm_store_ps(s.angVelX + i, Select(updated, wx, _mm_load_ps(s.angVelX + i)));
+			_mm_store_ps(s.angVelY + i, Select(updated, wy, _mm_load_ps(s.angVelY + i)));
+			_mm_store_ps(s.angVelZ + i, Select(updated, wz, _mm_load_ps(s.angVelZ + i)));
+
+			// counters, the common case is no faults at all
+			int iRenorm = _mm_movemask_ps(nonUnit) & iUpdated;
+			int iQuatBad = (_mm_movemask_ps(quatOk) ^ 0xF) & iUpdated;
+			int iPosBad = (_mm_movemask_ps(posOk) ^ 0xF) & iUpdated;
+			int iVelBad = (iLinClamped | iAngClamped) & iUpdated;
+			if (iRenorm | iQuatBad | iPosBad | iVelBad) {
+				for (uint32_t j = 0; j < 4; j++) {
+					HobovrDeviceStats_t& st = s.stats[i + j];
+					st.quatRenormalized += (iRenorm >> j) & 1;
+					st.quatRejected += (iQuatBad >> j) & 1;
+					st.posRejected += (iPosBad >> j) & 1;
+					st.velClamped += (iVelBad >> j) & 1;
+				}
+			}
+		}
+#else
+		static inline bool ClampVec3(float& x, float& y, float& z, float fMax) {
+			if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) {
+				x = y = z = 0.f;
+				return true;
+			}
+
+			float len2 = x*x + y*y + z*z;
+			if (len2 > fMax*fMax) {
+				float scale = fMax / std::sqrt(len2);
+				x *= scale;
+				y *= scale;
+				z *= scale;
+				return true;
+			}
+			return false;
+		}
+
+		void RunSlot(HobovrHotState_t& s, uint32_t i) {
+			if (!(s.flags[i] & EHotState_Updated))
+				return;
+
+			HobovrDeviceStats_t& st = s.stats[i];
+
+			bool posOk = std::isfinite(s.posX[i]) && std::isfinite(s.posY[i]) && std::isfinite(s.posZ[i]);
+
+			float n2 = s.rotW[i]*s.rotW[i] + s.rotX[i]*s.rotX[i] + s.rotY[i]*s.rotY[i] + s.rotZ[i]*s.rotZ[i];
+			bool quatOk = std::isfinite(n2) && n2 > k_fMinQuatNorm2;
+
+			if (quatOk) {
+				if (std::fabs(n2 - 1.f) > k_fUnitQuatTolerance)
+					st.quatRenormalized++;
+
+				float invLen = 1.f / std::sqrt(n2);
+				s.rotW[i] *= invLen;
+				s.rotX[i] *= invLen;
+				s.rotY[i] *= invLen;
+				s.rotZ[i] *= invLen;
+			} else {
+				st.quatRejected++;
+			}
+
+			if (!posOk)
+				st.posRejected++;
+
+			if (posOk && quatOk) {
+				m_vLastPosX[i] = s.posX[i];
+				m_vLastPosY[i] = s.posY[i];
+				m_vLastPosZ[i] = s.posZ[i];
+				m_vLastRotW[i] = s.rotW[i];
+				m_vLastRotX[i] = s.rotX[i];
+				m_vLastRotY[i] = s.rotY[i];
+				m_vLastRotZ[i] = s.rotZ[i];
+			} else {
+				s.posX[i] = m_vLastPosX[i];
+				s.posY[i] = m_vLastPosY[i];
+				s.posZ[i] = m_vLastPosZ[i];
+				s.rotW[i] = m_vLastRotW[i];
+				s.rotX[i] = m_vLastRotX[i];
+				s.rotY[i] = m_vLastRotY[i];
+				s.rotZ[i] = m_vLastRotZ[i];
+				s.velX[i] = s.velY[i] = s.velZ[i] = 0.f;
+				s.angVelX[i] = s.angVelY[i] = s.angVelZ[i] = 0.f;
+			}
+
+			bool linClamped = ClampVec3(s.velX[i], s.velY[i], s.velZ[i], m_fMaxLinVel);
+			bool angClamped = ClampVec3(s.angVelX[i], s.angVelY[i], s.angVelZ[i], m_fMaxAngVel);
+			if (linClamped || angClamped)
+				st.velClamped++;
+		}
+#endif
+
+		static constexpr float k_fMinQuatNorm2 = 1e-6f; // anything shorter is not a rotation
+		static constexpr float k_fUnitQuatTolerance = 1e-3f; // |q|^2 deviation that counts as non unit
+
+		float m_fMaxLinVel = 20.f; // m/s
+		float m_fMaxAngVel = 60.f; // rad/s
+
+		// last good pose of every slot
+		alignas(64) float m_vLastPosX[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastPosY[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastPosZ[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastRotW[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastRotX[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastRotY[k_unMaxHotStateDevices];
+		alignas(64) float m_vLastRotZ[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_POSE_VALIDATION_H
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_PREDICTION_H
+#define HOBOVR_PREDICTION_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class keys, read from the class's own section
+	static const char *const k_pch_Prediction_Enable_Bool = "PredictionEnable";
+	static const char *const k_pch_Prediction_MaxSeconds_Float = "PredictionMaxSeconds";
+	static const char *const k_pch_Prediction_MaxAcceleration_Float = "PredictionMaxAcceleration";
+
+	// smoothing of the linear acceleration estimate, raw velocity differences are noisy
+	static const float k_fPredictionAccelAlpha = 0.3f;
+
+	struct HobovrPredictionParams_t {
+		bool bEnable;
+		float fMaxSeconds; // prediction horizon clamp
+		float fMaxAcceleration; // m/s^2, acceleration estimate clamp, 0 disables the acceleration term
+	};
+
+	// moves updated hot state slots from their sample time to the predicted photon time
+	// horizon = sample age + display horizon, clamped per slot
+	// rotation is integrated through the quaternion exponential, position with velocity and estimated acceleration
+	// how far every slot got moved is left in HobovrHotState_t::predictedAhead, the pose time offset accounts for it
+	class HobovrPosePredictor {
+	public:
+		HobovrPosePredictor() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vParams[i] = {false, 0.f, 0.f};
+				ResetSlot(i);
+			}
+		}
+
+		// time from now to the photons of the frame being rendered, see SetDisplayTiming()
+		void SetDisplayHorizon(float fSeconds) {
+			m_fDisplayHorizon = fSeconds;
+		}
+
+		// one frame until the next vsync is rendered, plus the panel latency
+		void SetDisplayTiming(float fSecondsFromVsyncToPhotons, float fDisplayFrequency) {
+			SetDisplayHorizon(fSecondsFromVsyncToPhotons + (fDisplayFrequency > 0.f ? 1.f / fDisplayFrequency : 0.f));
+		}
+
+		void SetSlotParams(uint32_t i, const HobovrPredictionParams_t& params) {
+			m_vParams[i] = params;
+		}
+
+		// forget the motion history of slot i, use when the slot gets a new device
+		void ResetSlot(uint32_t i) {
+			m_vPrevVelX[i] = m_vPrevVelY[i] = m_vPrevVelZ[i] = 0.f;
+			m_vAccelX[i] = m_vAccelY[i] = m_vAccelZ[i] = 0.f;
+			m_vPrevTime[i] = 0.0;
+		}
+
+		// predicts updated slots in [begin, end), now is GetSteadySeconds()
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end, double now) {
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated))
+					continue;
+
+				UpdateAcceleration(s, i);
+
+				const HobovrPredictionParams_t& p = m_vParams[i];
+				float h = p.bEnable ? std::min(std::max((float)(now - s.sampleTime[i]) + m_fDisplayHorizon, 0.f), p.fMaxSeconds) : 0.f;
+				s.predictedAhead[i] = h;
+
+				if (h > 0.f)
+					PredictSlot(s, i, h);
+			}
+		}
+
+	private:
+		void UpdateAcceleration(const HobovrHotState_t& s, uint32_t i) {
+			double dt = s.sampleTime[i] - m_vPrevTime[i];
+
+			if (m_vPrevTime[i] > 0.0 && dt > 1e-4 && dt < 0.1) {
+				float inv = (float)(1.0 / dt);
+				float ax = (s.velX[i] - m_vPrevVelX[i]) * inv;
+				float ay = (s.velY[i] - m_vPrevVelY[i]) * inv;
+				float az = (s.velZ[i] - m_vPrevVelZ[i]) * inv;
+
+				m_vAccelX[i] += (ax - m_vAccelX[i]) * k_fPredictionAccelAlpha;
+				m_vAccelY[i] += (ay - m_vAccelY[i]) * k_fPredictionAccelAlpha;
+				m_vAccelZ[i] += (az - m_vAccelZ[i]) * k_fPredictionAccelAlpha;
+			} else {
+				m_vAccelX[i] = m_vAccelY[i] = m_vAccelZ[i] = 0.f; // first sample or a gap, no usable history
+			}
+
+			m_vPrevVelX[i] = s.velX[i];
+			m_vPrevVelY[i] = s.velY[i];
+			m_vPrevVelZ[i] = s.velZ[i];
+			m_vPrevTime[i] = s.sampleTime[i];
+		}
+
+		void PredictSlot(HobovrHotState_t& s, uint32_t i, float h) {
+			// clamped acceleration
+			float ax = m_vAccelX[i], ay = m_vAccelY[i], az = m_vAccelZ[i];
+			float aMax = m_vParams[i].fMaxAcceleration;
+			float a2 = ax*ax + ay*ay + az*az;
+			float aScale = a2 > aMax*aMax ? (aMax > 0.f ? aMax / std::sqrt(a2) : 0.f) : 1.f;
+			ax *= aScale;
+			ay *= aScale;
+			az *= aScale;
+
+			float hh = 0.5f*h*h;
+			s.posX[i] += s.velX[i]*h + ax*hh;
+			s.posY[i] += s.velY[i]*h + ay*hh;
+			s.posZ[i] += s.velZ[i]*h + az*hh;
+
+			s.velX[i] += ax*h;
+			s.velY[i] += ay*h;
+			s.velZ[i] += az*h;
+
+			// angular velocity is in driver space, so the delta rotation goes on the left
+			// dq = exp(w*h/2) = (cos(|w|h/2), sin(|w|h/2) * w/|w|)
+			float wx = s.angVelX[i], wy = s.angVelY[i], wz = s.angVelZ[i];
+			float wLen = std::sqrt(wx*wx + wy*wy + wz*wz);
+			float half = 0.5f*wLen*h;
+			float dw = std::cos(half);
+			float k = wLen > 1e-6f ? std::sin(half) / wLen : 0.5f*h; // sin(x)/x -> 1 near 0
+			float dx = wx*k, dy = wy*k, dz = wz*k;
+
+			float qw = s.rotW[i], qx = s.rotX[i], qy = s.rotY[i], qz = s.rotZ[i];
+			s.rotW[i] = dw*qw - dx*qx - dy*qy - dz*qz;
+			s.rotX[i] = dw*qx + dx*qw + dy*qz - dz*qy;
+			s.rotY[i] = dw*qy - dx*qz + dy*qw + dz*qx;
+			s.rotZ[i] = dw*qz + dx*qy - dy*qx + dz*qw;
+		}
+
+		HobovrPredictionParams_t m_vParams[k_unMaxHotStateDevices];
+		float m_fDisplayHorizon = 0.f;
+
+		float m_vPrevVelX[k_unMaxHotStateDevices];
+		float m_vPrevVelY[k_unMaxHotStateDevices];
+		float m_vPrevVelZ[k_unMaxHotStateDevices];
+		float m_vAccelX[k_unMaxHotStateDevices];
+		float m_vAccelY[k_unMaxHotStateDevices];
+		float m_vAccelZ[k_unMaxHotStateDevices];
+		double m_vPrevTime[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_PREDICTION_H
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_RATE_LIMITER_H
+#define HOBOVR_RATE_LIMITER_H
+
+#include <mutex>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class key, read from the class's own section, 0 or less is no limit
+	// "MaxSubmitRate_<serial>" in the same section overrides it for one device
+	static const char *const k_pch_RateLimit_MaxSubmitRate_Float = "MaxSubmitRate";
+
+	// caps how often each slot's pose is handed to vrserver, latest value wins
+	// poses that come in before a slot's interval is up are kept, a newer one replaces them,
+	// and the last one is flushed by the paced thread once the interval is up if nothing newer came along
+	// unlimited slots never take the lock
+	class HobovrRateLimiter {
+	public:
+		HobovrRateLimiter() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vInterval[i] = 0.0;
+				ResetSlot(i);
+			}
+		}
+
+		void SetSlotMaxRate(uint32_t i, float fHz) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vInterval[i] = fHz > 0.f ? 1.0 / (double)fHz : 0.0;
+			m_vbPending[i] = false;
+		}
+
+		void ResetSlot(uint32_t i) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vLastSubmit[i] = 0.0;
+			m_vbPending[i] = false;
+		}
+
+		bool IsLimited(uint32_t i) const {
+			return m_vInterval[i] > 0.0;
+		}
+
+		// receiver path, true if slot i can be submitted now, otherwise its pose in s is kept for TakePending()
+		bool Admit(const HobovrHotState_t& s, uint32_t i, double now) {
+			if (m_vInterval[i] <= 0.0)
+				return true;
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (now - m_vLastSubmit[i] >= m_vInterval[i]) {
+				m_vLastSubmit[i] = now;
+				m_vbPending[i] = false;
+				return true;
+			}
+
+			m_Pending.posX[i] = s.posX[i]; m_Pending.posY[i] = s.posY[i]; m_Pending.posZ[i] = s.posZ[i];
+			m_Pending.rotW[i] = s.rotW[i]; m_Pending.rotX[i] = s.rotX[i]; m_Pending.rotY[i] = s.rotY[i]; m_Pending.rotZ[i] = s.rotZ[i];
+			m_Pending.velX[i] = s.velX[i]; m_Pending.velY[i] = s.velY[i]; m_Pending.velZ[i] = s.velZ[i];
+			m_Pending.angVelX[i] = s.angVelX[i]; m_Pending.angVelY[i] = s.angVelY[i]; m_Pending.angVelZ[i] = s.angVelZ[i];
+			m_Pending.sampleTime[i] = s.sampleTime[i];
+			m_Pending.predictedAhead[i] = s.predictedAhead[i];
+			m_Pending.flags[i] = s.flags[i] & EHotState_PoserTimed;
+			m_vbPending[i] = true;
+			return false;
+		}
+
+		// paced path, the pose is made on the spot so nothing is kept, true if slot i can be submitted now
+		bool Consume(uint32_t i, double now) {
+			if (m_vInterval[i] <= 0.0)
+				return true;
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (now - m_vLastSubmit[i] < m_vInterval[i])
+				return false;
+
+			m_vLastSubmit[i] = now;
+			m_vbPending[i] = false;
+			return true;
+		}
+
+		// copies the kept pose of slot i into out once its interval is up, true if there was one
+		bool TakePending(uint32_t i, double now, HobovrHotState_t& out) {
+			if (m_vInterval[i] <= 0.0)
+				return false;
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_vbPending[i] || now - m_vLastSubmit[i] < m_vInterval[i])
+				return false;
+
+			out.posX[i] = m_Pending.posX[i]; out.posY[i] = m_Pending.posY[i]; out.posZ[i] = m_Pending.posZ[i];
+			out.rotW[i] = m_Pending.rotW[i]; out.rotX[i] = m_Pending.rotX[i]; out.rotY[i] = m_Pending.rotY[i]; out.rotZ[i] = m_Pending.rotZ[i];
+			out.velX[i] = m_Pending.velX[i]; out.velY[i] = m_Pending.velY[i]; out.velZ[i] = m_Pending.velZ[i];
+			out.angVelX[i] = m_Pending.angVelX[i]; out.angVelY[i] = m_Pending.angVelY[i]; out.angVelZ[i] = m_Pending.angVelZ[i];
+			out.sampleTime[i] = m_Pending.sampleTime[i];
+			out.predictedAhead[i] = m_Pending.predictedAhead[i];
+			out.flags[i] = (out.flags[i] & ~EHotState_PoserTimed) | m_Pending.flags[i];
+
+			m_vLastSubmit[i] = now;
+			m_vbPending[i] = false;
+			return true;
+		}
+
+	private:
+		std::mutex m_Mutex; // Admit() runs on the receiver thread, TakePending() on the paced thread
+		double m_vInterval[k_unMaxHotStateDevices]; // s, 0 for no limit
+		double m_vLastSubmit[k_unMaxHotStateDevices];
+		bool m_vbPending[k_unMaxHotStateDevices];
+		HobovrHotState_t m_Pending; // only the pose fields of pending slots are used
+	};
+}
+
+#endif // HOBOVR_RATE_LIMITER_H
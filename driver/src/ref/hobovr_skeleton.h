@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_SKELETON_H
+#define HOBOVR_SKELETON_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "hobovr_math.h"
+
+namespace hobovr {
+	// openvr hand skeleton bone indices
+	enum EHobovrHandBone {
+		EHandBone_Root = 0,
+		EHandBone_Wrist,
+		EHandBone_Thumb0, EHandBone_Thumb1, EHandBone_Thumb2, EHandBone_Thumb3,
+		EHandBone_Index0, EHandBone_Index1, EHandBone_Index2, EHandBone_Index3, EHandBone_Index4,
+		EHandBone_Middle0, EHandBone_Middle1, EHandBone_Middle2, EHandBone_Middle3, EHandBone_Middle4,
+		EHandBone_Ring0, EHandBone_Ring1, EHandBone_Ring2, EHandBone_Ring3, EHandBone_Ring4,
+		EHandBone_Pinky0, EHandBone_Pinky1, EHandBone_Pinky2, EHandBone_Pinky3, EHandBone_Pinky4,
+		EHandBone_AuxThumb, EHandBone_AuxIndex, EHandBone_AuxMiddle, EHandBone_AuxRing, EHandBone_AuxPinky,
+		EHandBone_Count
+	};
+
+	// compact hand state as sent by posers, packed into 2 floats of the device record
+	//   bytes 0-4: thumb, index, middle, ring, pinky curl, 0 open, 255 fully curled
+	//   byte 5: splay, 0 fingers together, 128 neutral, 255 spread
+	//   bytes 6-7: reserved, 0
+	static const int k_iSkeletonPacketSize = 2; // floats
+	static const int k_iFingerCount = 5;
+
+	// curl samples per finger, interpolated in between
+	static const int k_iSkeletonLutSteps = 16;
+
+	// procedural hand skeleton, curl driven
+	// every finger's bone transforms (parent space) are precomputed for k_iSkeletonLutSteps + 1 curl values
+	// at runtime adjacent samples get blended, positions lerped and rotations nlerped 4 floats at a time
+	class HobovrHandSkeleton {
+	public:
+		explicit HobovrHandSkeleton(bool bRightHand) {
+			BuildLut(bRightHand);
+		}
+
+		// expands a packed hand state into a full bone array of EHandBone_Count transforms
+		void Evaluate(const float* packed, vr::VRBoneTransform_t* bones) const {
+			uint8_t b[k_iSkeletonPacketSize*sizeof(float)];
+			memcpy(b, packed, sizeof(b));
+
+			bones[EHandBone_Root] = m_Root;
+			bones[EHandBone_Wrist] = m_Wrist;
+
+			for (int f = 0; f < k_iFingerCount; f++) {
+				float curl = (float)b[f] * (k_iSkeletonLutSteps / 255.f);
+				int step = std::min((int)curl, k_iSkeletonLutSteps - 1);
+				Blend(
+					m_vLut[f][step],
+					m_vLut[f][step + 1],
+					curl - (float)step,
+					k_iFingerBones[f],
+					bones + k_iFingerFirstBone[f]
+				);
+			}
+
+			// splay rotates the proximal bone of every finger away from the middle one
+			float splay = ((float)b[5] - 128.f) / 127.f;
+			for (int f = 0; f < k_iFingerCount; f++) {
+				vr::HmdQuaternionf_t q = Mirror(AxisAngleY(-splay * k_fSplayAngles[f])); // +y rotation turns +x toward -z, away from the thumb
+				vr::VRBoneTransform_t& proximal = bones[k_iFingerFirstBone[f] + 1];
+				proximal.orientation = Mul(q, proximal.orientation);
+			}
+
+			// aux bones are the distal bones in root space
+			for (int f = 0; f < k_iFingerCount; f++) {
+				int distal = k_iFingerFirstBone[f] + k_iFingerBones[f] - 2;
+				vr::VRBoneTransform_t t = Compose(bones[EHandBone_Root], bones[EHandBone_Wrist]);
+				for (int i = k_iFingerFirstBone[f]; i <= distal; i++)
+					t = Compose(t, bones[i]);
+
+				bones[EHandBone_AuxThumb + f] = t;
+			}
+		}
+
+	private:
+		static const int k_iMaxFingerBones = 5;
+
+		// first bone and number of bones of every finger, tips included
+		static constexpr int k_iFingerFirstBone[k_iFingerCount] = {EHandBone_Thumb0, EHandBone_Index0, EHandBone_Middle0, EHandBone_Ring0, EHandBone_Pinky0};
+		static constexpr int k_iFingerBones[k_iFingerCount] = {4, 5, 5, 5, 5};
+
+		// left hand layout, fingers point along +x, back of the hand is +y, thumb side is +z
+		// metacarpal base offsets from the wrist, meters
+		static constexpr float k_fMetacarpalBase[k_iFingerCount][3] = {
+			{0.020f, -0.010f, 0.020f},
+			{0.005f, 0.000f, 0.020f},
+			{0.005f, 0.000f, 0.000f},
+			{0.005f, 0.000f, -0.018f},
+			{0.000f, -0.003f, -0.034f},
+		};
+
+		// bone lengths, metacarpal first, the last bone (the tip) has no length
+		static constexpr float k_fBoneLengths[k_iFingerCount][k_iMaxFingerBones - 1] = {
+			{0.040f, 0.032f, 0.028f, 0.f},
+			{0.070f, 0.042f, 0.025f, 0.022f},
+			{0.068f, 0.046f, 0.028f, 0.024f},
+			{0.064f, 0.043f, 0.027f, 0.023f},
+			{0.060f, 0.034f, 0.020f, 0.020f},
+		};
+
+		// flex of every joint at full curl, radians, the tip never flexes
+		static constexpr float k_fFlexAngles[k_iFingerCount][k_iMaxFingerBones] = {
+			{0.35f, 0.70f, 0.90f, 0.f, 0.f},
+			{0.05f, 1.55f, 1.75f, 1.20f, 0.f},
+			{0.05f, 1.55f, 1.75f, 1.20f, 0.f},
+			{0.08f, 1.55f, 1.75f, 1.20f, 0.f},
+			{0.12f, 1.55f, 1.75f, 1.20f, 0.f},
+		};
+
+		// max splay of every proximal bone, radians, positive is toward the thumb
+		static constexpr float k_fSplayAngles[k_iFingerCount] = {0.30f, 0.15f, 0.f, -0.12f, -0.25f};
+
+		// rest yaw of every metacarpal, radians, positive is toward the thumb, fans the hand out a bit
+		static constexpr float k_fMetacarpalYaw[k_iFingerCount] = {0.80f, 0.08f, 0.f, -0.08f, -0.16f};
+
+		static vr::HmdQuaternionf_t AxisAngleY(float a) { return {std::cos(a*0.5f), 0.f, std::sin(a*0.5f), 0.f}; }
+		static vr::HmdQuaternionf_t AxisAngleZ(float a) { return {std::cos(a*0.5f), 0.f, 0.f, std::sin(a*0.5f)}; }
+
+		static vr::HmdQuaternionf_t Mul(const vr::HmdQuaternionf_t& a, const vr::HmdQuaternionf_t& b) {
+			return {
+				a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z,
+				a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+				a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+				a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w
+			};
+		}
+
+		static void Rotate(const vr::HmdQuaternionf_t& q, const float* v, float* out) {
+			// v + 2w(u x v) + 2u x (u x v)
+			float tx = 2.f*(q.y*v[2] - q.z*v[1]);
+			float ty = 2.f*(q.z*v[0] - q.x*v[2]);
+			float tz = 2.f*(q.x*v[1] - q.y*v[0]);
+			out[0] = v[0] + q.w*tx + (q.y*tz - q.z*ty);
+			out[1] = v[1] + q.w*ty + (q.z*tx - q.x*tz);
+			out[2] = v[2] + q.w*tz + (q.x*ty - q.y*tx);
+		}
+
+		// parent * child
+		static vr::VRBoneTransform_t Compose(const vr::VRBoneTransform_t& parent, const vr::VRBoneTransform_t& child) {
+			vr::VRBoneTransform_t out;
+			Rotate(parent.orientation, child.position.v, out.position.v);
+			for (int i = 0; i < 3; i++)
+				out.position.v[i] += parent.position.v[i];
+			out.position.v[3] = 1.f;
+			out.orientation = Mul(parent.orientation, child.orientation);
+			return out;
+		}
+
+		// reflection across the yz plane turns a left hand into a right one
+		vr::HmdQuaternionf_t Mirror(const vr::HmdQuaternionf_t& q) const {
+			return m_bRightHand ? vr::HmdQuaternionf_t{q.w, q.x, -q.y, -q.z} : q;
+		}
+
+		vr::VRBoneTransform_t Mirror(const vr::VRBoneTransform_t& t) const {
+			vr::VRBoneTransform_t out = t;
+			out.position.v[0] = m_bRightHand ? -t.position.v[0] : t.position.v[0];
+			out.orientation = Mirror(t.orientation);
+			return out;
+		}
+
+		void BuildLut(bool bRightHand) {
+			m_bRightHand = bRightHand;
+
+			m_Root = {{{0.f, 0.f, 0.f, 1.f}}, {1.f, 0.f, 0.f, 0.f}};
+
+			// wrist sits behind the controller, fingers pointing forward (-z)
+			m_Wrist = Mirror(vr::VRBoneTransform_t{{{0.f, 0.f, 0.1f, 1.f}}, AxisAngleY(1.5707963f)});
+
+			for (int f = 0; f < k_iFingerCount; f++) {
+				for (int s = 0; s <= k_iSkeletonLutSteps; s++) {
+					float curl = (float)s / k_iSkeletonLutSteps;
+					vr::VRBoneTransform_t* bones = m_vLut[f][s];
+
+					for (int i = 0; i < k_iFingerBones[f]; i++) {
+						vr::VRBoneTransform_t& t = bones[i];
+						if (i == 0) {
+							t.position = {{k_fMetacarpalBase[f][0], k_fMetacarpalBase[f][1], k_fMetacarpalBase[f][2], 1.f}};
+							t.orientation = Mul(AxisAngleY(-k_fMetacarpalYaw[f]), AxisAngleZ(-curl * k_fFlexAngles[f][0]));
+						} else {
+							t.position = {{k_fBoneLengths[f][i - 1], 0.f, 0.f, 1.f}};
+							t.orientation = AxisAngleZ(-curl * k_fFlexAngles[f][i]);
+						}
+
+						t = Mirror(t);
+					}
+
+					for (int i = k_iFingerBones[f]; i < k_iMaxFingerBones; i++)
+						bones[i] = m_Root;
+				}
+			}
+		}
+
+		// blends n bones of 2 lut samples, rotations are nlerped, adjacent samples are close so that is accurate enough
+		static void Blend(const vr::VRBoneTransform_t* a, const vr::VRBoneTransform_t* b, float t, int n, vr::VRBoneTransform_t* out) {
+#ifdef HOBOVR_USE_SSE2
+			__m128 vt = _mm_set1_ps(t);
+			for (int i = 0; i < n; i++) {
+				__m128 pa = _mm_loadu_ps(a[i].position.v);
+				__m128 pb = _mm_loadu_ps(b[i].position.v);
+				__m128 qa = _mm_loadu_ps(&a[i].orientation.w);
+				__m128 qb = _mm_loadu_ps(&b[i].orientation.w);
+
+				__m128 p = _mm_add_ps(pa, _mm_mul_ps(_mm_sub_ps(pb, pa), vt));
+				__m128 q = _mm_add_ps(qa, _mm_mul_ps(_mm_sub_ps(qb, qa), vt));
+
+				// horizontal dot for the length, shuffles keep it sse2 only
+				__m128 q2 = _mm_mul_ps(q, q);
+				__m128 s = _mm_add_ps(q2, _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(2, 3, 0, 1)));
+				s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+				q = _mm_div_ps(q, _mm_sqrt_ps(s));
+
+				_mm_storeu_ps(out[i].position.v, p);
+				_mm_storeu_ps(&out[i].orientation.w, q);
+			}
+#else
+			for (int i = 0; i < n; i++) {
+				float* p = out[i].position.v;
+				for (int k = 0; k < 4; k++)
+					p[k] = a[i].position.v[k] + (b[i].position.v[k] - a[i].position.v[k])*t;
+
+				const float* qa = &a[i].orientation.w;
+				const float* qb = &b[i].orientation.w;
+				float q[4];
+				for (int k = 0; k < 4; k++)
+					q[k] = qa[k] + (qb[k] - qa[k])*t;
+
+				float len = std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+				out[i].orientation = {q[0]/len, q[1]/len, q[2]/len, q[3]/len};
+			}
+#endif
+		}
+
+		bool m_bRightHand = false;
+		vr::VRBoneTransform_t m_Root;
+		vr::VRBoneTransform_t m_Wrist;
+		vr::VRBoneTransform_t m_vLut[k_iFingerCount][k_iSkeletonLutSteps + 1][k_iMaxFingerBones];
+	};
+}
+
+#endif // HOBOVR_SKELETON_H
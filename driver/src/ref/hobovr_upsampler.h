@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_UPSAMPLER_H
+#define HOBOVR_UPSAMPLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	static const char *const k_pch_Hobovr_UpsampleEnable_Bool = "UpsampleEnable";
+	static const char *const k_pch_Hobovr_UpsampleRate_Float = "UpsampleRate"; // Hz, 0 or less uses the hmd's displayFrequency
+	static const char *const k_pch_Hobovr_UpsampleLatency_Float = "UpsampleLatency"; // seconds poses are emitted behind real time
+	static const char *const k_pch_Hobovr_UpsampleMaxExtrapolation_Float = "UpsampleMaxExtrapolation"; // seconds past the newest sample
+
+	// samples kept per slot, two to interpolate between plus slack for a late tick
+	static const uint32_t k_unUpsampleHistory = 4;
+
+	// slots with no sample for this long stop being emitted
+	static const double k_fUpsampleStaleSeconds = 0.5;
+
+	// resamples the pipeline output of every slot at an arbitrary time
+	// Push() records samples as they arrive, Evaluate() is called from the paced thread
+	// between samples position is a cubic hermite on the sample velocities and rotation a slerp,
+	// past the newest sample both are extrapolated with the sample's velocities up to the max extrapolation
+	class HobovrPoseUpsampler {
+	public:
+		HobovrPoseUpsampler() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				ResetSlot(i);
+		}
+
+		void SetMaxExtrapolation(float fSeconds) {
+			m_fMaxExtrapolation = std::max(fSeconds, 0.f);
+		}
+
+		void ResetSlot(uint32_t i) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vSlot[i].count = 0;
+			m_vSlot[i].head = 0;
+		}
+
+		// records updated slots in [begin, end), the sample time is the time the (possibly predicted) pose describes
+		void Push(const HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated))
+					continue;
+
+				Slot_t& w = m_vSlot[i];
+				double t = s.sampleTime[i] + (double)s.predictedAhead[i];
+
+				// samples that aren't newer replace the newest one, time has to increase for the interpolation
+				if (!w.count || t > w.ring[w.head].time + 1e-5) {
+					w.head = (w.head + 1) % k_unUpsampleHistory;
+					w.count = std::min(w.count + 1, k_unUpsampleHistory);
+				}
+
+				Sample_t& n = w.ring[w.head];
+				n.time = t;
+				n.pos[0] = s.posX[i]; n.pos[1] = s.posY[i]; n.pos[2] = s.posZ[i];
+				n.rot[0] = s.rotW[i]; n.rot[1] = s.rotX[i]; n.rot[2] = s.rotY[i]; n.rot[3] = s.rotZ[i];
+				n.vel[0] = s.velX[i]; n.vel[1] = s.velY[i]; n.vel[2] = s.velZ[i];
+				n.angVel[0] = s.angVelX[i]; n.angVel[1] = s.angVelY[i]; n.angVel[2] = s.angVelZ[i];
+			}
+		}
+
+		// writes the pose of slot i at time t into slot i of out
+		// out.sampleTime is the time the written pose describes, returns false if there is nothing recent to emit
+		bool Evaluate(uint32_t i, double t, HobovrHotState_t& out) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const Slot_t& w = m_vSlot[i];
+
+			if (!w.count || t - w.ring[w.head].time > k_fUpsampleStaleSeconds)
+				return false;
+
+			// newest pair (a, b) with a.time <= t, falls through to the newest sample when t is past it
+			const Sample_t* a = &w.ring[w.head];
+			const Sample_t* b = nullptr;
+			for (uint32_t k = 1; k < w.count && a->time > t; k++) {
+				b = a;
+				a = &w.ring[(w.head + k_unUpsampleHistory - k) % k_unUpsampleHistory];
+			}
+
+			Sample_t r;
+			if (b != nullptr && a->time <= t) {
+				Interpolate(*a, *b, t, r);
+			} else if (b == nullptr) {
+				double h = std::min(t - a->time, (double)m_fMaxExtrapolation);
+				Extrapolate(*a, (float)std::max(h, 0.0), r);
+			} else {
+				r = *a; // older than the whole history, hold the oldest sample
+			}
+
+			out.posX[i] = r.pos[0]; out.posY[i] = r.pos[1]; out.posZ[i] = r.pos[2];
+			out.rotW[i] = r.rot[0]; out.rotX[i] = r.rot[1]; out.rotY[i] = r.rot[2]; out.rotZ[i] = r.rot[3];
+			out.velX[i] = r.vel[0]; out.velY[i] = r.vel[1]; out.velZ[i] = r.vel[2];
+			out.angVelX[i] = r.angVel[0]; out.angVelY[i] = r.angVel[1]; out.angVelZ[i] = r.angVel[2];
+			out.sampleTime[i] = r.time;
+			out.predictedAhead[i] = 0.f;
+
+			return true;
+		}
+
+	private:
+		struct Sample_t {
+			double time;
+			float pos[3];
+			float rot[4]; // wxyz
+			float vel[3];
+			float angVel[3];
+		};
+
+		struct Slot_t {
+			Sample_t ring[k_unUpsampleHistory];
+			uint32_t head; // index of the newest sample
+			uint32_t count;
+		};
+
+		static void Interpolate(const Sample_t& a, const Sample_t& b, double t, Sample_t& r) {
+			float dt = (float)(b.time - a.time);
+			float u = (float)(t - a.time) / dt;
+			float u2 = u*u, u3 = u2*u;
+
+			// hermite basis and its derivative
+			float h00 = 2*u3 - 3*u2 + 1, h10 = u3 - 2*u2 + u, h01 = -2*u3 + 3*u2, h11 = u3 - u2;
+			float d00 = 6*u2 - 6*u, d10 = 3*u2 - 4*u + 1, d01 = -6*u2 + 6*u, d11 = 3*u2 - 2*u;
+
+			// zero velocities mean the poser didn't send any, use the chord instead of flattening the curve
+			bool bVelA = a.vel[0] != 0.f || a.vel[1] != 0.f || a.vel[2] != 0.f;
+			bool bVelB = b.vel[0] != 0.f || b.vel[1] != 0.f || b.vel[2] != 0.f;
+
+			for (int j = 0; j < 3; j++) {
+				float chord = b.pos[j] - a.pos[j];
+				float m0 = bVelA ? a.vel[j]*dt : chord;
+				float m1 = bVelB ? b.vel[j]*dt : chord;
+
+				r.pos[j] = h00*a.pos[j] + h10*m0 + h01*b.pos[j] + h11*m1;
+				r.vel[j] = (d00*a.pos[j] + d10*m0 + d01*b.pos[j] + d11*m1) / dt;
+				r.angVel[j] = a.angVel[j] + (b.angVel[j] - a.angVel[j])*u;
+			}
+
+			Slerp(a.rot, b.rot, u, r.rot);
+			r.time = t;
+		}
+
+		static void Extrapolate(const Sample_t& a, float h, Sample_t& r) {
+			r = a;
+			r.time = a.time + h;
+
+			for (int j = 0; j < 3; j++)
+				r.pos[j] += a.vel[j]*h;
+
+			// driver space angular velocity, delta rotation on the left, see HobovrPosePredictor
+			float wLen = std::sqrt(a.angVel[0]*a.angVel[0] + a.angVel[1]*a.angVel[1] + a.angVel[2]*a.angVel[2]);
+			float half = 0.5f*wLen*h;
+			float k = wLen > 1e-6f ? std::sin(half) / wLen : 0.5f*h;
+			float dw = std::cos(half), dx = a.angVel[0]*k, dy = a.angVel[1]*k, dz = a.angVel[2]*k;
+			const float* q = a.rot;
+
+			r.rot[0] = dw*q[0] - dx*q[1] - dy*q[2] - dz*q[3];
+			r.rot[1] = dw*q[1] + dx*q[0] + dy*q[3] - dz*q[2];
+			r.rot[2] = dw*q[2] - dx*q[3] + dy*q[0] + dz*q[1];
+			r.rot[3] = dw*q[3] + dx*q[2] - dy*q[1] + dz*q[0];
+		}
+
+		static void Slerp(const float* a, const float* b, float u, float* r) {
+			float bb[4] = {b[0], b[1], b[2], b[3]};
+			float dot = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+			if (dot < 0.f) { // short way around
+				for (int j = 0; j < 4; j++)
+					bb[j] = -bb[j];
+				dot = -dot;
+			}
+
+			float wa = 1.f - u, wb = u;
+			if (dot < 0.9995f) { // nlerp is exact enough for nearly equal rotations and avoids dividing by sin(~0)
+				float theta = std::acos(dot);
+				float invSin = 1.f / std::sin(theta);
+				wa = std::sin(wa*theta) * invSin;
+				wb = std::sin(wb*theta) * invSin;
+			}
+
+			float len2 = 0.f;
+			for (int j = 0; j < 4; j++) {
+				r[j] = wa*a[j] + wb*bb[j];
+				len2 += r[j]*r[j];
+			}
+
+			float invLen = 1.f / std::sqrt(len2);
+			for (int j = 0; j < 4; j++)
+				r[j] *= invLen;
+		}
+
+		std::mutex m_Mutex; // Push() runs on the receiver thread, Evaluate() on the paced thread
+		float m_fMaxExtrapolation = 0.05f;
+		Slot_t m_vSlot[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_UPSAMPLER_H
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_VELOCITY_H
+#define HOBOVR_VELOCITY_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class key, read from the class's own section
+	static const char *const k_pch_VelocityEstimate_Enable_Bool = "VelocityEstimateEnable";
+
+	// samples kept per slot for the fit
+	static const uint32_t k_unVelocityWindow = 6;
+
+	// only samples this recent take part in the fit, older ones describe motion that is over
+	static const float k_fVelocityWindowSeconds = 0.1f;
+
+	// fills in velocities the poser didn't send
+	// linear velocity is the least squares slope of the positions in the window over time
+	// angular velocity is the least squares slope of the rotation vectors log(q_newest * q_k^-1)
+	// only zero velocities are replaced, the validator zeroes NaN/Inf ones so those are replaced too
+	class HobovrVelocityEstimator {
+	public:
+		HobovrVelocityEstimator() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vbEnable[i] = false;
+				ResetSlot(i);
+			}
+		}
+
+		void SetSlotEnabled(uint32_t i, bool bEnable) {
+			if (bEnable && !m_vbEnable[i])
+				ResetSlot(i);
+
+			m_vbEnable[i] = bEnable;
+		}
+
+		// forget the history of slot i
+		void ResetSlot(uint32_t i) {
+			m_vSlot[i].count = 0;
+			m_vSlot[i].head = 0;
+		}
+
+		// records the pose of updated slots in [begin, end) and fills in their missing velocities
+		void Run(HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated) || !m_vbEnable[i])
+					continue;
+
+				Push(s, i);
+
+				bool bNoVel = s.velX[i] == 0.f && s.velY[i] == 0.f && s.velZ[i] == 0.f;
+				bool bNoAngVel = s.angVelX[i] == 0.f && s.angVelY[i] == 0.f && s.angVelZ[i] == 0.f;
+
+				if ((bNoVel || bNoAngVel) && m_vSlot[i].count > 1)
+					Estimate(s, i, bNoVel, bNoAngVel);
+			}
+		}
+
+	private:
+		struct Sample_t {
+			double time;
+			float pos[3];
+			float rot[4]; // wxyz
+		};
+
+		struct Slot_t {
+			Sample_t ring[k_unVelocityWindow];
+			uint32_t head; // index of the newest sample
+			uint32_t count;
+		};
+
+		void Push(const HobovrHotState_t& s, uint32_t i) {
+			Slot_t& w = m_vSlot[i];
+			double dt = w.count ? s.sampleTime[i] - w.ring[w.head].time : 0.0;
+
+			if (w.count && (dt < 0.0 || dt > k_fVelocityWindowSeconds))
+				w.count = 0; // time went backwards or a gap, the history doesn't connect
+
+			// samples with the same time stamp replace the newest one, they would break the fit
+			if (!w.count || dt > 1e-5) {
+				w.head = (w.head + 1) % k_unVelocityWindow;
+				w.count = std::min(w.count + 1, k_unVelocityWindow);
+			}
+
+			Sample_t& n = w.ring[w.head];
+			n.time = s.sampleTime[i];
+			n.pos[0] = s.posX[i];
+			n.pos[1] = s.posY[i];
+			n.pos[2] = s.posZ[i];
+			n.rot[0] = s.rotW[i];
+			n.rot[1] = s.rotX[i];
+			n.rot[2] = s.rotY[i];
+			n.rot[3] = s.rotZ[i];
+		}
+
+		void Estimate(HobovrHotState_t& s, uint32_t i, bool bLinear, bool bAngular) {
+			const Slot_t& w = m_vSlot[i];
+			const Sample_t& newest = w.ring[w.head];
+
+			// times relative to the newest sample, rotations as the rotation vector from sample k to the newest
+			// q_newest = exp(w*(t_newest - t_k)) * q_k, so -log(q_newest * q_k^-1) is linear in t_k - t_newest with slope w
+			float t[k_unVelocityWindow];
+			float p[k_unVelocityWindow][3];
+			float r[k_unVelocityWindow][3];
+			uint32_t n = 0;
+
+			for (uint32_t k = 0; k < w.count; k++) {
+				const Sample_t& a = w.ring[(w.head + k_unVelocityWindow - k) % k_unVelocityWindow];
+				float tk = (float)(a.time - newest.time);
+				if (tk < -k_fVelocityWindowSeconds)
+					break;
+
+				t[n] = tk;
+				p[n][0] = a.pos[0];
+				p[n][1] = a.pos[1];
+				p[n][2] = a.pos[2];
+				QuatLogDelta(a.rot, newest.rot, r[n]);
+				n++;
+			}
+
+			if (n < 2)
+				return;
+
+			float tMean = 0.f, pMean[3] = {}, rMean[3] = {};
+			for (uint32_t k = 0; k < n; k++) {
+				tMean += t[k];
+				for (int j = 0; j < 3; j++) {
+					pMean[j] += p[k][j];
+					rMean[j] += r[k][j];
+				}
+			}
+
+			float invN = 1.f / n;
+			tMean *= invN;
+			for (int j = 0; j < 3; j++) {
+				pMean[j] *= invN;
+				rMean[j] *= invN;
+			}
+
+			float stt = 0.f, stp[3] = {}, str[3] = {};
+			for (uint32_t k = 0; k < n; k++) {
+				float dt = t[k] - tMean;
+				stt += dt*dt;
+				for (int j = 0; j < 3; j++) {
+					stp[j] += dt*(p[k][j] - pMean[j]);
+					str[j] += dt*(r[k][j] - rMean[j]);
+				}
+			}
+
+			if (stt < 1e-10f)
+				return;
+
+			float invStt = 1.f / stt;
+
+			if (bLinear) {
+				s.velX[i] = stp[0] * invStt;
+				s.velY[i] = stp[1] * invStt;
+				s.velZ[i] = stp[2] * invStt;
+			}
+
+			if (bAngular) {
+				s.angVelX[i] = str[0] * invStt;
+				s.angVelY[i] = str[1] * invStt;
+				s.angVelZ[i] = str[2] * invStt;
+			}
+		}
+
+		// out = -log(newest * conj(q)), the driver space rotation vector that takes newest back to q
+		static void QuatLogDelta(const float* q, const float* newest, float* out) {
+			// d = newest * conj(q)
+			float dw =  newest[0]*q[0] + newest[1]*q[1] + newest[2]*q[2] + newest[3]*q[3];
+			float dx = -newest[0]*q[1] + newest[1]*q[0] - newest[2]*q[3] + newest[3]*q[2];
+			float dy = -newest[0]*q[2] + newest[1]*q[3] + newest[2]*q[0] - newest[3]*q[1];
+			float dz = -newest[0]*q[3] - newest[1]*q[2] + newest[2]*q[1] + newest[3]*q[0];
+
+			if (dw < 0.f) { // short way around
+				dw = -dw; dx = -dx; dy = -dy; dz = -dz;
+			}
+
+			float vLen = std::sqrt(dx*dx + dy*dy + dz*dz);
+			float k = vLen > 1e-7f ? -2.f * std::atan2(vLen, dw) / vLen : -2.f; // angle/|v| -> 2 near 0
+
+			out[0] = dx * k;
+			out[1] = dy * k;
+			out[2] = dz * k;
+		}
+
+		bool m_vbEnable[k_unMaxHotStateDevices];
+		Slot_t m_vSlot[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_VELOCITY_H
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_VSYNC_SCHEDULER_H
+#define HOBOVR_VSYNC_SCHEDULER_H
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	static const char *const k_pch_Hobovr_VsyncSubmitEnable_Bool = "VsyncSubmitEnable";
+	static const char *const k_pch_Hobovr_VsyncSubmitMargin_Float = "VsyncSubmitMargin"; // seconds poses are submitted ahead of the compositor reading them
+
+	// steamvr's running start, where the pose read is assumed to be before each vsync while there's no compositor timing
+	static const double k_fVsyncAssumedReadLead = 0.003;
+
+	enum EHobovrVsyncSource {
+		EVsyncSource_Settings = 0, // displayFrequency only, the phase is a guess
+		EVsyncSource_Compositor = 1, // phase taken from the compositor's frame timing
+	};
+
+	// models when the compositor reads poses and keeps the freshest pipeline output until then
+	// reads are one display period apart, at anchor + k*period, the anchor comes from the compositor's frame timing
+	// (the frame's vsync plus when its poses were ready) or from the vsync timeline alone while there's none
+	// the paced thread wakes up margin before every read and submits what Take() hands it,
+	// so submissions have a fixed phase to the display and a poser running close to the display rate can't beat against it
+	// Push() runs on the receiver thread, the rest on the paced thread
+	class HobovrVsyncScheduler {
+	public:
+		HobovrVsyncScheduler() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++)
+				ResetSlot(i);
+		}
+
+		void SetDisplayTiming(float fDisplayFrequency, float fMargin) {
+			m_fPeriod = fDisplayFrequency > 0.f ? 1.0 / (double)fDisplayFrequency : 1.0 / 90.0;
+			m_fMargin = std::min(std::max((double)fMargin, 0.0), m_fPeriod);
+		}
+
+		// vsyncTime is when the compositor's frame started, readOffset when after that its poses were read
+		// anything off the timeline falls back to the settings model
+		void SetCompositorTiming(double vsyncTime, double readOffset) {
+			if (vsyncTime <= 0.0 || readOffset < 0.0 || readOffset > 2.0*m_fPeriod) {
+				SetSettingsTiming();
+				return;
+			}
+
+			m_fAnchor = vsyncTime + readOffset;
+			m_eSource = EVsyncSource_Compositor;
+		}
+
+		void SetSettingsTiming() {
+			m_fAnchor = -k_fVsyncAssumedReadLead;
+			m_eSource = EVsyncSource_Settings;
+		}
+
+		EHobovrVsyncSource GetSource() const { return m_eSource; }
+		double GetPeriod() const { return m_fPeriod; }
+
+		// next submission time after now, margin before the read it is for
+		double NextSubmitTime(double now) const {
+			double k = std::floor((now + m_fMargin - m_fAnchor) / m_fPeriod) + 1.0;
+			return m_fAnchor + k*m_fPeriod - m_fMargin;
+		}
+
+		void ResetSlot(uint32_t i) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vbFresh[i] = false;
+		}
+
+		// keeps the pipeline output of updated slots in [begin, end), newer samples replace older ones
+		void Push(const HobovrHotState_t& s, uint32_t begin, uint32_t end) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated))
+					continue;
+
+				m_Latest.posX[i] = s.posX[i]; m_Latest.posY[i] = s.posY[i]; m_Latest.posZ[i] = s.posZ[i];
+				m_Latest.rotW[i] = s.rotW[i]; m_Latest.rotX[i] = s.rotX[i]; m_Latest.rotY[i] = s.rotY[i]; m_Latest.rotZ[i] = s.rotZ[i];
+				m_Latest.velX[i] = s.velX[i]; m_Latest.velY[i] = s.velY[i]; m_Latest.velZ[i] = s.velZ[i];
+				m_Latest.angVelX[i] = s.angVelX[i]; m_Latest.angVelY[i] = s.angVelY[i]; m_Latest.angVelZ[i] = s.angVelZ[i];
+				m_Latest.sampleTime[i] = s.sampleTime[i];
+				m_Latest.predictedAhead[i] = s.predictedAhead[i];
+				m_Latest.flags[i] = s.flags[i] & EHotState_PoserTimed;
+				m_vbFresh[i] = true;
+			}
+		}
+
+		// copies the freshest pose of slot i into out, false if nothing came in since the last read,
+		// the compositor extrapolates the previous one with its velocities then
+		bool Take(uint32_t i, HobovrHotState_t& out) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_vbFresh[i])
+				return false;
+
+			out.posX[i] = m_Latest.posX[i]; out.posY[i] = m_Latest.posY[i]; out.posZ[i] = m_Latest.posZ[i];
+			out.rotW[i] = m_Latest.rotW[i]; out.rotX[i] = m_Latest.rotX[i]; out.rotY[i] = m_Latest.rotY[i]; out.rotZ[i] = m_Latest.rotZ[i];
+			out.velX[i] = m_Latest.velX[i]; out.velY[i] = m_Latest.velY[i]; out.velZ[i] = m_Latest.velZ[i];
+			out.angVelX[i] = m_Latest.angVelX[i]; out.angVelY[i] = m_Latest.angVelY[i]; out.angVelZ[i] = m_Latest.angVelZ[i];
+			out.sampleTime[i] = m_Latest.sampleTime[i];
+			out.predictedAhead[i] = m_Latest.predictedAhead[i];
+			out.flags[i] = (out.flags[i] & ~EHotState_PoserTimed) | m_Latest.flags[i];
+
+			m_vbFresh[i] = false;
+			return true;
+		}
+
+	private:
+		double m_fPeriod = 1.0 / 90.0; // s
+		double m_fMargin = 0.001; // s
+		double m_fAnchor = -k_fVsyncAssumedReadLead; // a pose read, steady seconds
+		EHobovrVsyncSource m_eSource = EVsyncSource_Settings;
+
+		std::mutex m_Mutex;
+		bool m_vbFresh[k_unMaxHotStateDevices];
+		HobovrHotState_t m_Latest; // only the pose fields of fresh slots are used
+	};
+}
+
+#endif // HOBOVR_VSYNC_SCHEDULER_H
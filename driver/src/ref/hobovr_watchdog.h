@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_WATCHDOG_H
+#define HOBOVR_WATCHDOG_H
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "hobovr_hot_state.h"
+
+namespace hobovr {
+	// per device class keys, read from the class's own section
+	static const char *const k_pch_Watchdog_Enable_Bool = "WatchdogEnable";
+	static const char *const k_pch_Watchdog_StaleSeconds_Float = "WatchdogStaleSeconds"; // silence before the stream counts as stalled
+	static const char *const k_pch_Watchdog_BridgeSeconds_Float = "WatchdogBridgeSeconds"; // dead reckoning after that, then the device is lost
+	static const char *const k_pch_Watchdog_VelocityDecay_Float = "WatchdogVelocityDecay"; // s, time constant of the dead reckoning velocity
+
+	struct HobovrWatchdogParams_t {
+		bool bEnable;
+		float fStaleSeconds;
+		float fBridgeSeconds;
+		float fDecaySeconds;
+	};
+
+	enum EHobovrWatchdogAction {
+		EWatchdog_None = 0, // the stream is live, nothing to do
+		EWatchdog_Bridge = 1, // out holds a dead reckoned pose, submit it as usual
+		EWatchdog_Lost = 2, // out holds the last bridged pose, submit it as out of range, only returned once
+		EWatchdog_Held = 3, // already reported lost, wait for samples
+	};
+
+	// catches posers that stall without closing their socket
+	// sparse frames leave idle devices out on purpose, so any frame from the poser keeps every device fresh,
+	// a device goes stale once the stream has been quiet for its class's stale time
+	// stale devices are dead reckoned from their last sample with a decaying velocity:
+	//   pos = p + v*T*(1 - exp(-t/T)), same for the rotation with the angular velocity
+	// after the bridge time they are reported lost, the next sample brings them back
+	// Push() runs on the receiver thread, Evaluate() on the paced thread
+	class HobovrStreamWatchdog {
+	public:
+		HobovrStreamWatchdog() {
+			for (uint32_t i = 0; i < k_unMaxHotStateDevices; i++) {
+				m_vParams[i] = {false, 0.05f, 0.1f, 0.05f};
+				ResetSlot(i);
+			}
+		}
+
+		void SetSlotParams(uint32_t i, const HobovrWatchdogParams_t& params) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vParams[i] = params;
+		}
+
+		void ResetSlot(uint32_t i) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_vSlot[i] = {};
+		}
+
+		// records the pipeline output of updated slots in [begin, end), any call counts as the stream being alive
+		void Push(const HobovrHotState_t& s, uint32_t begin, uint32_t end, double now) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_fStreamTime = now;
+
+			for (uint32_t i = begin; i < end; i++) {
+				if (!(s.flags[i] & EHotState_Updated))
+					continue;
+
+				Slot_t& w = m_vSlot[i];
+				w.time = s.sampleTime[i] + (double)s.predictedAhead[i];
+				w.pos[0] = s.posX[i]; w.pos[1] = s.posY[i]; w.pos[2] = s.posZ[i];
+				w.rot[0] = s.rotW[i]; w.rot[1] = s.rotX[i]; w.rot[2] = s.rotY[i]; w.rot[3] = s.rotZ[i];
+				w.vel[0] = s.velX[i]; w.vel[1] = s.velY[i]; w.vel[2] = s.velZ[i];
+				w.angVel[0] = s.angVelX[i]; w.angVel[1] = s.angVelY[i]; w.angVel[2] = s.angVelZ[i];
+				w.action = EWatchdog_None; // samples resumed, the device recovers with this very pose
+			}
+		}
+
+		// what to do with slot i at time now, Bridge and Lost write the pose to submit into slot i of out
+		EHobovrWatchdogAction Evaluate(uint32_t i, double now, HobovrHotState_t& out) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const HobovrWatchdogParams_t& p = m_vParams[i];
+			Slot_t& w = m_vSlot[i];
+
+			if (!p.bEnable || w.time <= 0.0 || now - m_fStreamTime <= (double)p.fStaleSeconds)
+				return EWatchdog_None;
+
+			if (w.action == EWatchdog_Lost || w.action == EWatchdog_Held) {
+				w.action = EWatchdog_Held;
+				return EWatchdog_Held;
+			}
+
+			float t = (float)std::max(now - w.time, 0.0);
+			bool bLost = now - m_fStreamTime > (double)(p.fStaleSeconds + p.fBridgeSeconds);
+			if (bLost) // stop where the bridge ended
+				t = (float)std::max(m_fStreamTime + (double)(p.fStaleSeconds + p.fBridgeSeconds) - w.time, 0.0);
+
+			// integral of the decaying velocity and what is left of it
+			float reach = p.fDecaySeconds > 0.f ? p.fDecaySeconds*(1.f - std::exp(-t / p.fDecaySeconds)) : 0.f;
+			float left = bLost || p.fDecaySeconds <= 0.f ? 0.f : std::exp(-t / p.fDecaySeconds);
+
+			out.posX[i] = w.pos[0] + w.vel[0]*reach;
+			out.posY[i] = w.pos[1] + w.vel[1]*reach;
+			out.posZ[i] = w.pos[2] + w.vel[2]*reach;
+			out.velX[i] = w.vel[0]*left;
+			out.velY[i] = w.vel[1]*left;
+			out.velZ[i] = w.vel[2]*left;
+			out.angVelX[i] = w.angVel[0]*left;
+			out.angVelY[i] = w.angVel[1]*left;
+			out.angVelZ[i] = w.angVel[2]*left;
+
+			// driver space angular velocity, delta rotation on the left, see HobovrPosePredictor
+			float wLen = std::sqrt(w.angVel[0]*w.angVel[0] + w.angVel[1]*w.angVel[1] + w.angVel[2]*w.angVel[2]);
+			float half = 0.5f*wLen*reach;
+			float k = wLen > 1e-6f ? std::sin(half) / wLen : 0.5f*reach;
+			float dw = std::cos(half), dx = w.angVel[0]*k, dy = w.angVel[1]*k, dz = w.angVel[2]*k;
+			const float* q = w.rot;
+
+			out.rotW[i] = dw*q[0] - dx*q[1] - dy*q[2] - dz*q[3];
+			out.rotX[i] = dw*q[1] + dx*q[0] + dy*q[3] - dz*q[2];
+			out.rotY[i] = dw*q[2] - dx*q[3] + dy*q[0] + dz*q[1];
+			out.rotZ[i] = dw*q[3] + dx*q[2] - dy*q[1] + dz*q[0];
+
+			out.sampleTime[i] = w.time + (double)t;
+			out.predictedAhead[i] = 0.f;
+
+			w.action = bLost ? EWatchdog_Lost : EWatchdog_Bridge;
+			return w.action;
+		}
+
+	private:
+		struct Slot_t {
+			double time; // time the last sample describes, 0 if there is none
+			float pos[3];
+			float rot[4]; // wxyz
+			float vel[3];
+			float angVel[3];
+			EHobovrWatchdogAction action; // last thing Evaluate() asked for
+		};
+
+		std::mutex m_Mutex;
+		double m_fStreamTime = 0.0; // last time the poser was heard from
+		HobovrWatchdogParams_t m_vParams[k_unMaxHotStateDevices];
+		Slot_t m_vSlot[k_unMaxHotStateDevices];
+	};
+}
+
+#endif // HOBOVR_WATCHDOG_H
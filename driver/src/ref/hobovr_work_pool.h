@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+// Copyright (C) 2020-2021 Oleg Vorobiov <oleg.vorobiov@hobovrlabs.org>
+
+#pragma once
+
+#ifndef HOBOVR_WORK_POOL_H
+#define HOBOVR_WORK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hobovr {
+	static const char *const k_pch_Hobovr_PipelineThreads_Int32 = "PipelineThreads"; // worker threads, 0 picks from the core count, read on startup
+	static const char *const k_pch_Hobovr_PipelineParallelMinDevices_Int32 = "PipelineParallelMinDevices"; // smaller udu lists run serially
+
+	// participants of a job, the calling thread plus the workers
+	static const uint32_t k_unMaxWorkPoolParticipants = 16;
+
+	// small fork/join pool for splitting a range of slots over a few threads
+	// every participant starts with a contiguous share of the chunks and takes them from the front,
+	// once it runs out it steals from the back of the others' shares, a share is one 64 bit atomic so both ends are lock free
+	// ParallelFor() returns once every chunk is done and every worker is out of the job, that is the barrier
+	// one job at a time, ParallelFor() is meant to be called from one thread
+	class HobovrWorkPool {
+	public:
+		~HobovrWorkPool() {
+			Stop();
+		}
+
+		void Start(uint32_t unWorkers) {
+			Stop();
+
+			m_unWorkers = std::min(unWorkers, k_unMaxWorkPoolParticipants - 1);
+			m_bStop = false;
+			for (uint32_t i = 0; i < m_unWorkers; i++)
+				m_vThreads.emplace_back(&HobovrWorkPool::WorkerThread, this, i + 1);
+		}
+
+		void Stop() {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_bStop = true;
+			}
+			m_WakeCv.notify_all();
+
+			for (auto& i : m_vThreads)
+				i.join();
+
+			m_vThreads.clear();
+			m_unWorkers = 0;
+		}
+
+		uint32_t GetWorkerCount() const { return m_unWorkers; }
+
+		// calls fn(begin, end) over [0, count) in chunks of grain, begins are always multiples of grain
+		// runs inline when there are no workers or only one chunk
+		template <typename F>
+		void ParallelFor(uint32_t count, uint32_t grain, const F& fn) {
+			uint32_t chunks = (count + grain - 1) / grain;
+
+			if (m_unWorkers == 0 || chunks <= 1) {
+				fn(0u, count);
+				return;
+			}
+
+			m_pfnJob = [](const void* ctx, uint32_t begin, uint32_t end) { (*(const F*)ctx)(begin, end); };
+			m_pJobCtx = &fn;
+			m_unCount = count;
+			m_unGrain = grain;
+
+			uint32_t participants = m_unWorkers + 1;
+			for (uint32_t p = 0; p < participants; p++)
+				m_vShares[p].range.store(PackRange(chunks*p / participants, chunks*(p + 1) / participants), std::memory_order_relaxed);
+
+			m_unChunksLeft.store(chunks, std::memory_order_relaxed);
+			m_unWorkersBusy.store(m_unWorkers, std::memory_order_relaxed);
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_ulGeneration++;
+			}
+			m_WakeCv.notify_all();
+
+			Participate(0);
+
+			// barrier, workers must be out before the next job reuses the shares
+			while (m_unChunksLeft.load(std::memory_order_acquire) || m_unWorkersBusy.load(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+
+	private:
+		typedef void (*JobFn)(const void* ctx, uint32_t begin, uint32_t end);
+
+		struct alignas(64) Share_t {
+			std::atomic<uint64_t> range; // [lo, hi) chunk indices, lo in the low half
+		};
+
+		static uint64_t PackRange(uint64_t lo, uint64_t hi) {
+			return lo | (hi << 32);
+		}
+
+		// owner end
+		bool PopFront(uint32_t p, uint32_t& chunk) {
+			uint64_t r = m_vShares[p].range.load(std::memory_order_relaxed);
+			for (;;) {
+				uint32_t lo = (uint32_t)r, hi = (uint32_t)(r >> 32);
+				if (lo >= hi)
+					return false;
+
+				if (m_vShares[p].range.compare_exchange_weak(r, PackRange(lo + 1, hi), std::memory_order_acq_rel)) {
+					chunk = lo;
+					return true;
+				}
+			}
+		}
+
+		// thief end
+		bool PopBack(uint32_t p, uint32_t& chunk) {
+			uint64_t r = m_vShares[p].range.load(std::memory_order_relaxed);
+			for (;;) {
+				uint32_t lo = (uint32_t)r, hi = (uint32_t)(r >> 32);
+				if (lo >= hi)
+					return false;
+
+				if (m_vShares[p].range.compare_exchange_weak(r, PackRange(lo, hi - 1), std::memory_order_acq_rel)) {
+					chunk = hi - 1;
+					return true;
+				}
+			}
+		}
+
+		void Participate(uint32_t self) {
+			uint32_t participants = m_unWorkers + 1;
+			uint32_t chunk;
+
+			for (;;) {
+				bool bGot = PopFront(self, chunk);
+				for (uint32_t k = 1; !bGot && k < participants; k++)
+					bGot = PopBack((self + k) % participants, chunk);
+
+				if (!bGot)
+					return; // everything is taken, the rest is finishing on other threads
+
+				uint32_t begin = chunk*m_unGrain;
+				m_pfnJob(m_pJobCtx, begin, std::min(begin + m_unGrain, m_unCount));
+				m_unChunksLeft.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		void WorkerThread(uint32_t self) {
+			uint64_t seen = 0;
+
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					m_WakeCv.wait(lock, [&] { return m_bStop || m_ulGeneration != seen; });
+					if (m_bStop)
+						return;
+
+					seen = m_ulGeneration;
+				}
+
+				Participate(self);
+				m_unWorkersBusy.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		}
+
+		uint32_t m_unWorkers = 0;
+		std::vector<std::thread> m_vThreads;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCv;
+		uint64_t m_ulGeneration = 0; // bumped for every job
+		bool m_bStop = false;
+
+		// the current job, written before the generation bump so workers see it after waking
+		JobFn m_pfnJob = nullptr;
+		const void* m_pJobCtx = nullptr;
+		uint32_t m_unCount = 0;
+		uint32_t m_unGrain = 1;
+		Share_t m_vShares[k_unMaxWorkPoolParticipants];
+		std::atomic<uint32_t> m_unChunksLeft{0};
+		std::atomic<uint32_t> m_unWorkersBusy{0};
+	};
+}
+
+#endif // HOBOVR_WORK_POOL_H
@@ -18,6 +18,7 @@
 #pragma comment (lib, "AdvApi32.lib")
 
 #include "util.h"
+#include "hobovr_frames.h"
 
 #include <vector>
 #include <string>
@@ -41,6 +42,7 @@ namespace SockReceiver {
     std::vector<int> m_viEps;
     int m_iExpectedMessageSize;
     std::string m_sIdMessage = "hello\n";
+    std::chrono::steady_clock::time_point m_tLastPacketTime; // when the bytes of the packet currently passed to the callback came off the socket
 
     DriverReceiver(std::string expected_pose_struct, int port=6969) {
       std::regex rgx("[htc]");
@@ -201,8 +203,10 @@ namespace SockReceiver {
       while (m_bThreadKeepAlive){
         m_bThreadReset = false;
         int numbit = 0, msglen;
-        int l_iTempMsgSize = m_iExpectedMessageSize*4*10;
+        // room for a few dense frames or two of the largest frame the decoders take, whichever is more
+        int l_iTempMsgSize = std::max(m_iExpectedMessageSize*4*10, hobovr::MaxFrameBytes(m_iExpectedMessageSize)*2);
         char* l_cpRecvBuffer = new char[l_iTempMsgSize];
+        std::chrono::steady_clock::time_point l_tLastRecv = std::chrono::steady_clock::now();
 
       #ifdef DRIVERLOG_H
             DriverLog("receiver thread started\n");
@@ -210,10 +214,13 @@ namespace SockReceiver {
 
         while (m_bThreadKeepAlive && !m_bThreadReset) {
           try {
-            msglen = receive_till_zero(m_pSocketObject, l_cpRecvBuffer, numbit, l_iTempMsgSize);
+            msglen = receive_till_zero(m_pSocketObject, l_cpRecvBuffer, numbit, l_iTempMsgSize, l_tLastRecv);
 
             if (msglen == -1 || m_bThreadReset) break;
 
+            // when the bytes arrived, not when parsing starts, so queueing in the buffer counts as age
+            m_tLastPacketTime = l_tLastRecv;
+
             if (!m_bThreadReset)
               if (m_pCallback != nullptr)
                 m_pCallback->OnPacket(l_cpRecvBuffer, msglen);
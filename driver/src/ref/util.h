@@ -7,6 +7,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <chrono>
 #include <vector>
 #include <iterator>
 #include <regex>
@@ -15,8 +16,9 @@
 
 namespace SockReceiver {
   //can receive packets ending with \t\r\n using either winsock2 or unix sockets
+  // lastRecv is set whenever bytes come off the socket, every message in the buffer arrived by then
   template <typename T>
-  int receive_till_zero( T sock, char* buf, int& numbytes, int max_packet_size )
+  int receive_till_zero( T sock, char* buf, int& numbytes, int max_packet_size, std::chrono::steady_clock::time_point& lastRecv )
   {
     // receives a message until an end token is reached
     // thanks to https://stackoverflow.com/a/13528453/10190971
@@ -30,6 +32,13 @@ namespace SockReceiver {
           return i + 3; // return length of message
         }
       }
+      // full and still no terminator, drop what's buffered and resync on the next terminator
+      // reading with no room left would return 0 forever
+      if( numbytes >= max_packet_size ) {
+        numbytes = 0;
+        i = 0;
+      }
+
       if constexpr(std::is_same<T, SOCKET>::value)
       {
         n = recv( sock, buf + numbytes, max_packet_size - numbytes, 0 );
@@ -47,6 +56,7 @@ namespace SockReceiver {
       if( n == -1 ) {
         return -1; // operation failed!
       }
+      lastRecv = std::chrono::steady_clock::now();
       numbytes += n;
     } while( true );
   }